@@ -40,6 +40,8 @@ static struct fpi_frame_asmbl_ctx assembling_ctx = {
   .frame_height = AESX660_FRAME_HEIGHT,
   .image_width = IMAGE_WIDTH,
   .get_pixel = aes_get_pixel,
+  .bits_per_pixel = 4,
+  .column_major = TRUE,
 };
 
 static const FpIdEntry id_table[] = {
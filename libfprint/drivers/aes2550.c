@@ -55,10 +55,9 @@ struct _FpiDeviceAes2550
 {
   FpImageDevice parent;
 
-  GSList       *strips;
-  size_t        strips_len;
-  gboolean      deactivating;
-  int           heartbeat_cnt;
+  FpiFrameAssembler *assembler;
+  gboolean           deactivating;
+  int                heartbeat_cnt;
 };
 G_DECLARE_FINAL_TYPE (FpiDeviceAes2550, fpi_device_aes2550, FPI, DEVICE_AES2550,
                       FpImageDevice);
@@ -69,6 +68,8 @@ static struct fpi_frame_asmbl_ctx assembling_ctx = {
   .frame_height = FRAME_HEIGHT,
   .image_width = IMAGE_WIDTH,
   .get_pixel = aes_get_pixel,
+  .bits_per_pixel = 4,
+  .column_major = TRUE,
 };
 
 /****** FINGER PRESENCE DETECTION ******/
@@ -203,13 +204,12 @@ process_strip_data (FpiSsm *ssm, FpImageDevice *dev,
   len = data[1] * 256 + data[2];
   if (len != (AES2550_STRIP_SIZE - 3))
     fp_dbg ("Bogus frame len: %.4x\n", len);
-  stripe = g_malloc0 (FRAME_WIDTH * FRAME_HEIGHT / 2 + sizeof (struct fpi_frame));     /* 4 bits per pixel */
+  stripe = fpi_frame_assembler_get_next_frame (self->assembler);
   stripe->delta_x = (int8_t) data[6];
   stripe->delta_y = -(int8_t) data[7];
   stripdata = stripe->data;
-  memcpy (stripdata, data + 33, FRAME_WIDTH * FRAME_HEIGHT / 2);
-  self->strips = g_slist_prepend (self->strips, stripe);
-  self->strips_len++;
+  memcpy (stripdata, data + 33, FRAME_WIDTH * FRAME_HEIGHT / 2);     /* 4 bits per pixel */
+  fpi_frame_assembler_add_frame (self->assembler);
 
   fp_dbg ("deltas: %dx%d", stripe->delta_x, stripe->delta_y);
 
@@ -224,15 +224,11 @@ capture_set_idle_reqs_cb (FpiUsbTransfer *transfer,
   FpImageDevice *dev = FP_IMAGE_DEVICE (device);
   FpiDeviceAes2550 *self = FPI_DEVICE_AES2550 (dev);
 
-  if (!error && self->strips_len)
+  if (!error && fpi_frame_assembler_get_n_frames (self->assembler))
     {
       FpImage *img;
 
-      self->strips = g_slist_reverse (self->strips);
-      img = fpi_assemble_frames (&assembling_ctx, self->strips);
-      g_slist_free_full (self->strips, g_free);
-      self->strips = NULL;
-      self->strips_len = 0;
+      img = fpi_frame_assembler_finish (self->assembler);
       fpi_image_device_image_captured (dev, img);
       fpi_image_device_report_finger_status (dev, FALSE);
       /* marking machine complete will re-trigger finger detection loop */
@@ -521,20 +517,21 @@ complete_deactivation (FpImageDevice *dev)
   G_DEBUG_HERE ();
 
   self->deactivating = FALSE;
-  g_slist_free (self->strips);
-  self->strips = NULL;
-  self->strips_len = 0;
+  fpi_frame_assembler_reset (self->assembler);
   fpi_image_device_deactivate_complete (dev, NULL);
 }
 
 static void
 dev_init (FpImageDevice *dev)
 {
+  FpiDeviceAes2550 *self = FPI_DEVICE_AES2550 (dev);
   GError *error = NULL;
 
   /* TODO check that device has endpoints we're using */
 
-  g_usb_device_claim_interface (fpi_device_get_usb_device (FP_DEVICE (dev)), 0, 0, &error);
+  if (g_usb_device_claim_interface (fpi_device_get_usb_device (FP_DEVICE (dev)), 0, 0, &error))
+    /* The device estimates the movement of the frames itself */
+    self->assembler = fpi_frame_assembler_new (&assembling_ctx, FALSE);
 
   fpi_image_device_open_complete (dev, error);
 }
@@ -542,8 +539,11 @@ dev_init (FpImageDevice *dev)
 static void
 dev_deinit (FpImageDevice *dev)
 {
+  FpiDeviceAes2550 *self = FPI_DEVICE_AES2550 (dev);
   GError *error = NULL;
 
+  g_clear_pointer (&self->assembler, fpi_frame_assembler_free);
+
   g_usb_device_release_interface (fpi_device_get_usb_device (FP_DEVICE (dev)),
                                   0, 0, &error);
   fpi_image_device_close_complete (dev, error);
@@ -30,8 +30,7 @@
 typedef struct
 {
   GByteArray         *stripe_packet;
-  GSList             *strips;
-  size_t              strips_len;
+  FpiFrameAssembler  *assembler;
   gboolean            deactivating;
   struct aesX660_cmd *init_seq;
   size_t              init_seq_len;
@@ -293,7 +292,7 @@ process_stripe_data (FpiSsm *ssm, FpiDeviceAesX660 *self,
       return 0;
     }
 
-  stripe = g_malloc (cls->assembling_ctx->frame_width * FRAME_HEIGHT / 2 + sizeof (struct fpi_frame));     /* 4 bpp */
+  stripe = fpi_frame_assembler_get_next_frame (priv->assembler);
   stripdata = stripe->data;
 
   fp_dbg ("Processing frame %.2x %.2x", data[AESX660_IMAGE_OK_OFFSET],
@@ -305,14 +304,12 @@ process_stripe_data (FpiSsm *ssm, FpiDeviceAesX660 *self,
 
   if (data[AESX660_IMAGE_OK_OFFSET] == AESX660_IMAGE_OK)
     {
-      memcpy (stripdata, data + AESX660_IMAGE_OFFSET, cls->assembling_ctx->frame_width * FRAME_HEIGHT / 2);
+      memcpy (stripdata, data + AESX660_IMAGE_OFFSET, cls->assembling_ctx->frame_width * FRAME_HEIGHT / 2);     /* 4 bpp */
 
-      priv->strips = g_slist_prepend (priv->strips, stripe);
-      priv->strips_len++;
+      fpi_frame_assembler_add_frame (priv->assembler);
       return data[AESX660_LAST_FRAME_OFFSET] & AESX660_LAST_FRAME_BIT;
     }
 
-  g_free (stripe);
   return 0;
 }
 
@@ -323,18 +320,12 @@ capture_set_idle_cmd_cb (FpiUsbTransfer *transfer, FpDevice *device,
   FpImageDevice *dev = FP_IMAGE_DEVICE (device);
   FpiDeviceAesX660 *self = FPI_DEVICE_AES_X660 (device);
   FpiDeviceAesX660Private *priv = fpi_device_aes_x660_get_instance_private (self);
-  FpiDeviceAesX660Class *cls = FPI_DEVICE_AES_X660_GET_CLASS (self);
 
   if (!error)
     {
       FpImage *img;
 
-      priv->strips = g_slist_reverse (priv->strips);
-      img = fpi_assemble_frames (cls->assembling_ctx, priv->strips);
-      g_slist_foreach (priv->strips, (GFunc) g_free, NULL);
-      g_slist_free (priv->strips);
-      priv->strips = NULL;
-      priv->strips_len = 0;
+      img = fpi_frame_assembler_finish (priv->assembler);
       fpi_image_device_image_captured (dev, img);
       fpi_image_device_report_finger_status (dev, FALSE);
       fpi_ssm_mark_completed (transfer->ssm);
@@ -439,7 +430,7 @@ capture_run_state (FpiSsm *ssm, FpDevice *_dev)
       break;
 
     case CAPTURE_SET_IDLE:
-      fp_dbg ("Got %lu frames\n", priv->strips_len);
+      fp_dbg ("Got %u frames\n", fpi_frame_assembler_get_n_frames (priv->assembler));
       aesX660_send_cmd (ssm, _dev, set_idle_cmd, sizeof (set_idle_cmd),
                         capture_set_idle_cmd_cb);
       break;
@@ -686,11 +677,14 @@ aesX660_dev_init (FpImageDevice *dev)
 {
   FpiDeviceAesX660 *self = FPI_DEVICE_AES_X660 (dev);
   FpiDeviceAesX660Private *priv = fpi_device_aes_x660_get_instance_private (self);
+  FpiDeviceAesX660Class *cls = FPI_DEVICE_AES_X660_GET_CLASS (self);
   GError *error = NULL;
 
   g_usb_device_claim_interface (fpi_device_get_usb_device (FP_DEVICE (dev)), 0, 0, &error);
 
   priv->stripe_packet = g_byte_array_new ();
+  /* The device estimates the movement of the frames itself */
+  priv->assembler = fpi_frame_assembler_new (cls->assembling_ctx, FALSE);
 
   fpi_image_device_open_complete (dev, error);
 }
@@ -706,6 +700,7 @@ aesX660_dev_deinit (FpImageDevice *dev)
                                   0, 0, &error);
 
   g_clear_pointer (&priv->stripe_packet, g_byte_array_unref);
+  g_clear_pointer (&priv->assembler, fpi_frame_assembler_free);
 
   fpi_image_device_close_complete (dev, error);
 }
@@ -720,9 +715,7 @@ complete_deactivation (FpImageDevice *dev)
   G_DEBUG_HERE ();
 
   priv->deactivating = FALSE;
-  g_slist_free (priv->strips);
-  priv->strips = NULL;
-  priv->strips_len = 0;
+  fpi_frame_assembler_reset (priv->assembler);
   fpi_image_device_deactivate_complete (dev, NULL);
 }
 
@@ -77,6 +77,7 @@ typedef struct
 
   /* State for tasks */
   gboolean wait_for_finger;
+  guint    identify_max_results;
 } FpDevicePrivate;
 
 static void fp_device_async_initable_iface_init (GAsyncInitableIface *iface);
@@ -1069,24 +1070,14 @@ fp_device_verify_finish (FpDevice     *device,
   return res != FPI_MATCH_ERROR;
 }
 
-/**
- * fp_device_identify:
- * @device: a #FpDevice
- * @prints: (element-type FpPrint) (transfer none): #GPtrArray of #FpPrint
- * @cancellable: (nullable): a #GCancellable, or %NULL
- * @callback: the function to call on completion
- * @user_data: the data to pass to @callback
- *
- * Start an asynchronous operation to identify prints. The callback will
- * be called once the operation has finished. Retrieve the result with
- * fp_device_identify_finish().
- */
-void
-fp_device_identify (FpDevice           *device,
-                    GPtrArray          *prints,
-                    GCancellable       *cancellable,
-                    GAsyncReadyCallback callback,
-                    gpointer            user_data)
+static void
+fp_device_start_identify (FpDevice           *device,
+                          GPtrArray          *prints,
+                          FpPrintGallery     *gallery,
+                          guint               max_results,
+                          GCancellable       *cancellable,
+                          GAsyncReadyCallback callback,
+                          gpointer            user_data)
 {
   g_autoptr(GTask) task = NULL;
   FpDevicePrivate *priv = fp_device_get_instance_private (device);
@@ -1111,15 +1102,88 @@ fp_device_identify (FpDevice           *device,
 
   priv->current_action = FP_DEVICE_ACTION_IDENTIFY;
   priv->current_task = g_steal_pointer (&task);
+  priv->identify_max_results = max_results;
   maybe_cancel_on_cancelled (device, cancellable);
 
+  /* Drivers that do not know about galleries just get all of its prints */
+  if (gallery)
+    {
+      GPtrArray *gallery_prints = fp_print_gallery_get_prints (gallery);
+      guint i;
+
+      g_object_set_data_full (G_OBJECT (priv->current_task),
+                              "gallery",
+                              g_object_ref (gallery),
+                              g_object_unref);
+
+      prints = g_ptr_array_new_full (gallery_prints->len, g_object_unref);
+      for (i = 0; i < gallery_prints->len; i++)
+        g_ptr_array_add (prints, g_object_ref (g_ptr_array_index (gallery_prints, i)));
+    }
+  else
+    {
+      g_ptr_array_ref (prints);
+    }
+
   g_task_set_task_data (priv->current_task,
-                        g_ptr_array_ref (prints),
+                        prints,
                         (GDestroyNotify) g_ptr_array_unref);
 
   FP_DEVICE_GET_CLASS (device)->verify (device);
 }
 
+/**
+ * fp_device_identify:
+ * @device: a #FpDevice
+ * @prints: (element-type FpPrint) (transfer none): #GPtrArray of #FpPrint
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Start an asynchronous operation to identify prints. The callback will
+ * be called once the operation has finished. Retrieve the result with
+ * fp_device_identify_finish().
+ */
+void
+fp_device_identify (FpDevice           *device,
+                    GPtrArray          *prints,
+                    GCancellable       *cancellable,
+                    GAsyncReadyCallback callback,
+                    gpointer            user_data)
+{
+  fp_device_start_identify (device, prints, NULL, 0, cancellable, callback, user_data);
+}
+
+/**
+ * fp_device_identify_gallery:
+ * @device: a #FpDevice
+ * @gallery: The #FpPrintGallery to identify against
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Start an asynchronous operation to identify prints. This is the same as
+ * fp_device_identify(), but makes use of the data that @gallery prepared
+ * for its prints. Changes to @gallery do not affect an ongoing operation.
+ * Retrieve the result with fp_device_identify_finish().
+ *
+ * Large galleries are first compared against the prints their index ranks
+ * as the most likely matches, and only in full if none of those matches.
+ * So if several prints of @gallery match, the one that is returned may
+ * differ from the one fp_device_identify() returns.
+ */
+void
+fp_device_identify_gallery (FpDevice           *device,
+                            FpPrintGallery     *gallery,
+                            GCancellable       *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer            user_data)
+{
+  g_return_if_fail (FP_IS_PRINT_GALLERY (gallery));
+
+  fp_device_start_identify (device, NULL, gallery, 0, cancellable, callback, user_data);
+}
+
 /**
  * fp_device_identify_finish:
  * @device: A #FpDevice
@@ -1162,6 +1226,96 @@ fp_device_identify_finish (FpDevice     *device,
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+/**
+ * fp_device_identify_ranked:
+ * @device: a #FpDevice
+ * @prints: (element-type FpPrint) (transfer none): #GPtrArray of #FpPrint
+ * @max_results: The maximum number of candidates to return
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Start an asynchronous operation to identify prints, ranking the best
+ * @max_results prints of the gallery by their score rather than only
+ * returning the first match. The callback will be called once the operation
+ * has finished. Retrieve the result with fp_device_identify_ranked_finish().
+ */
+void
+fp_device_identify_ranked (FpDevice           *device,
+                           GPtrArray          *prints,
+                           guint               max_results,
+                           GCancellable       *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer            user_data)
+{
+  g_return_if_fail (max_results > 0);
+
+  fp_device_start_identify (device, prints, NULL, max_results, cancellable, callback, user_data);
+}
+
+/**
+ * fp_device_identify_ranked_finish:
+ * @device: A #FpDevice
+ * @result: A #GAsyncResult
+ * @candidates: (out) (transfer full) (element-type FpMatchCandidate) (nullable): Location
+ *   for the #FpMatchCandidate list, or %NULL
+ * @print: (out) (transfer full) (nullable): Location for the new #FpPrint, or %NULL
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Finish an asynchronous operation to identify a print with ranked results.
+ * The @candidates are sorted by descending score and include prints that
+ * scored below the match threshold of the driver, use
+ * fp_match_candidate_is_match() to tell them apart.
+ *
+ * Devices that cannot report scores return at most the matching print, with
+ * a score of -1.
+ *
+ * See fp_device_identify_ranked().
+ *
+ * Returns: (type void): %FALSE on error, %TRUE otherwise
+ */
+gboolean
+fp_device_identify_ranked_finish (FpDevice     *device,
+                                  GAsyncResult *result,
+                                  GPtrArray   **candidates,
+                                  FpPrint     **print,
+                                  GError      **error)
+{
+  if (print)
+    {
+      *print = g_object_get_data (G_OBJECT (result), "print");
+      if (*print)
+        g_object_ref (*print);
+    }
+  if (candidates)
+    {
+      FpPrint *match;
+
+      *candidates = g_object_get_data (G_OBJECT (result), "candidates");
+      if (*candidates)
+        {
+          g_ptr_array_ref (*candidates);
+        }
+      else
+        {
+          *candidates = g_ptr_array_new_with_free_func ((GDestroyNotify) fp_match_candidate_unref);
+
+          match = g_object_get_data (G_OBJECT (result), "match");
+          if (match)
+            g_ptr_array_add (*candidates, fpi_match_candidate_new (match, -1, TRUE));
+        }
+    }
+
+  if (!g_task_propagate_boolean (G_TASK (result), error))
+    {
+      if (candidates)
+        g_clear_pointer (candidates, g_ptr_array_unref);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
 /**
  * fp_device_capture:
  * @device: a #FpDevice
@@ -1684,6 +1838,51 @@ fpi_device_get_identify_data (FpDevice   *device,
     *prints = g_task_get_task_data (priv->current_task);
 }
 
+/**
+ * fpi_device_get_identify_gallery:
+ * @device: The #FpDevice
+ *
+ * Get the #FpPrintGallery if the identify operation was started using
+ * fp_device_identify_gallery(). The prints returned by
+ * fpi_device_get_identify_data() are a snapshot of the prints in the
+ * gallery in that case.
+ *
+ * Returns: (transfer none) (nullable): The #FpPrintGallery, or %NULL
+ */
+FpPrintGallery *
+fpi_device_get_identify_gallery (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), NULL);
+  g_return_val_if_fail (priv->current_action == FP_DEVICE_ACTION_IDENTIFY, NULL);
+
+  return g_object_get_data (G_OBJECT (priv->current_task), "gallery");
+}
+
+/**
+ * fpi_device_get_identify_max_results:
+ * @device: The #FpDevice
+ *
+ * Get the number of ranked candidates requested by the identify operation.
+ * This is 0 for a plain identify, which only needs the first match and
+ * should be completed using fpi_device_identify_complete(). Otherwise
+ * the driver should complete with fpi_device_identify_ranked_complete()
+ * if it is able to score the prints.
+ *
+ * Returns: The maximum number of candidates to report
+ */
+guint
+fpi_device_get_identify_max_results (FpDevice *device)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), 0);
+  g_return_val_if_fail (priv->current_action == FP_DEVICE_ACTION_IDENTIFY, 0);
+
+  return priv->identify_max_results;
+}
+
 /**
  * fpi_device_get_delete_data:
  * @device: The #FpDevice
@@ -2171,6 +2370,50 @@ fpi_device_identify_complete (FpDevice *device,
     }
 }
 
+/**
+ * fpi_device_identify_ranked_complete:
+ * @device: The #FpDevice
+ * @candidates: (element-type FpMatchCandidate) (transfer full) (nullable): The
+ *   best scoring #FpMatchCandidate list, sorted by descending score
+ * @print: The scanned #FpPrint, may be %NULL
+ * @error: The #GError or %NULL on success
+ *
+ * Finish an ongoing identify operation that was started using
+ * fp_device_identify_ranked(). The first candidate is also reported as
+ * the match if it scored high enough.
+ */
+void
+fpi_device_identify_ranked_complete (FpDevice  *device,
+                                     GPtrArray *candidates,
+                                     FpPrint   *print,
+                                     GError    *error)
+{
+  FpDevicePrivate *priv = fp_device_get_instance_private (device);
+  FpPrint *match = NULL;
+
+  g_return_if_fail (FP_IS_DEVICE (device));
+  g_return_if_fail (priv->current_action == FP_DEVICE_ACTION_IDENTIFY);
+
+  if (!error && candidates)
+    {
+      if (candidates->len > 0 &&
+          fp_match_candidate_is_match (g_ptr_array_index (candidates, 0)))
+        match = g_object_ref (fp_match_candidate_get_print (g_ptr_array_index (candidates, 0)));
+
+      g_object_set_data_full (G_OBJECT (priv->current_task),
+                              "candidates",
+                              g_steal_pointer (&candidates),
+                              (GDestroyNotify) g_ptr_array_unref);
+    }
+  else if (candidates)
+    {
+      g_warning ("Driver passed an error but also provided candidates, returning error!");
+      g_ptr_array_unref (candidates);
+    }
+
+  fpi_device_identify_complete (device, match, print, error);
+}
+
 
 /**
  * fpi_device_capture_complete:
@@ -2504,6 +2747,82 @@ fp_device_identify_sync (FpDevice     *device,
   return fp_device_identify_finish (device, task, match, print, error);
 }
 
+/**
+ * fp_device_identify_gallery_sync:
+ * @device: a #FpDevice
+ * @gallery: The #FpPrintGallery to identify against
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @match: (out) (transfer full) (nullable): Location for the matched #FpPrint, or %NULL
+ * @print: (out) (transfer full) (nullable): Location for the new #FpPrint, or %NULL
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Identify a print against a #FpPrintGallery synchronously. See
+ * fp_device_identify_gallery() for how this differs from
+ * fp_device_identify_sync().
+ *
+ * Returns: (type void): %FALSE on error, %TRUE otherwise
+ */
+gboolean
+fp_device_identify_gallery_sync (FpDevice       *device,
+                                 FpPrintGallery *gallery,
+                                 GCancellable   *cancellable,
+                                 FpPrint       **match,
+                                 FpPrint       **print,
+                                 GError        **error)
+{
+  g_autoptr(GAsyncResult) task = NULL;
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
+
+  fp_device_identify_gallery (device,
+                              gallery,
+                              cancellable,
+                              async_result_ready, &task);
+  while (!task)
+    g_main_context_iteration (NULL, TRUE);
+
+  return fp_device_identify_finish (device, task, match, print, error);
+}
+
+/**
+ * fp_device_identify_ranked_sync:
+ * @device: a #FpDevice
+ * @prints: (element-type FpPrint) (transfer none): #GPtrArray of #FpPrint
+ * @max_results: The maximum number of candidates to return
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @candidates: (out) (transfer full) (element-type FpMatchCandidate) (nullable): Location
+ *   for the #FpMatchCandidate list, or %NULL
+ * @print: (out) (transfer full) (nullable): Location for the new #FpPrint, or %NULL
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Identify a print synchronously with ranked results.
+ *
+ * Returns: (type void): %FALSE on error, %TRUE otherwise
+ */
+gboolean
+fp_device_identify_ranked_sync (FpDevice     *device,
+                                GPtrArray    *prints,
+                                guint         max_results,
+                                GCancellable *cancellable,
+                                GPtrArray   **candidates,
+                                FpPrint     **print,
+                                GError      **error)
+{
+  g_autoptr(GAsyncResult) task = NULL;
+
+  g_return_val_if_fail (FP_IS_DEVICE (device), FALSE);
+
+  fp_device_identify_ranked (device,
+                             prints,
+                             max_results,
+                             cancellable,
+                             async_result_ready, &task);
+  while (!task)
+    g_main_context_iteration (NULL, TRUE);
+
+  return fp_device_identify_ranked_finish (device, task, candidates, print, error);
+}
+
 
 /**
  * fp_device_capture_sync:
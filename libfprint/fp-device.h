@@ -32,6 +32,7 @@ G_BEGIN_DECLS
 G_DECLARE_DERIVABLE_TYPE (FpDevice, fp_device, FP, DEVICE, GObject)
 
 #include "fp-print.h"
+#include "fp-print-gallery.h"
 
 /* NOTE: We keep the class struct private! */
 
@@ -168,6 +169,19 @@ void fp_device_identify (FpDevice           *device,
                          GAsyncReadyCallback callback,
                          gpointer            user_data);
 
+void fp_device_identify_gallery (FpDevice           *device,
+                                 FpPrintGallery     *gallery,
+                                 GCancellable       *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer            user_data);
+
+void fp_device_identify_ranked (FpDevice           *device,
+                                GPtrArray          *prints,
+                                guint               max_results,
+                                GCancellable       *cancellable,
+                                GAsyncReadyCallback callback,
+                                gpointer            user_data);
+
 void fp_device_capture (FpDevice           *device,
                         gboolean            wait_for_finger,
                         GCancellable       *cancellable,
@@ -204,6 +218,11 @@ gboolean fp_device_identify_finish (FpDevice     *device,
                                     FpPrint     **match,
                                     FpPrint     **print,
                                     GError      **error);
+gboolean fp_device_identify_ranked_finish (FpDevice     *device,
+                                           GAsyncResult *result,
+                                           GPtrArray   **candidates,
+                                           FpPrint     **print,
+                                           GError      **error);
 FpImage * fp_device_capture_finish (FpDevice     *device,
                                     GAsyncResult *result,
                                     GError      **error);
@@ -239,6 +258,19 @@ gboolean fp_device_identify_sync (FpDevice     *device,
                                   FpPrint     **match,
                                   FpPrint     **print,
                                   GError      **error);
+gboolean fp_device_identify_gallery_sync (FpDevice       *device,
+                                          FpPrintGallery *gallery,
+                                          GCancellable   *cancellable,
+                                          FpPrint       **match,
+                                          FpPrint       **print,
+                                          GError        **error);
+gboolean fp_device_identify_ranked_sync (FpDevice     *device,
+                                         GPtrArray    *prints,
+                                         guint         max_results,
+                                         GCancellable *cancellable,
+                                         GPtrArray   **candidates,
+                                         FpPrint     **print,
+                                         GError      **error);
 FpImage * fp_device_capture_sync (FpDevice     *device,
                                   gboolean      wait_for_finger,
                                   GCancellable *cancellable,
@@ -28,6 +28,12 @@
 #define MIN_ACCEPTABLE_MINUTIAE 10
 #define BOZORTH3_DEFAULT_THRESHOLD 40
 #define IMG_ENROLL_STAGES 5
+/* Captures with fewer blocks containing ridges are rejected before the
+ * minutiae detection runs. A print covering a quarter of the width and
+ * height of the sensor still passes. */
+#define MIN_FOREGROUND_RATIO 0.1
+/* Below this squared deviation a rejected image is taken as empty */
+#define MAX_BLANK_SQ_DEV 100
 
 /**
  * SECTION: fp-image-device
@@ -59,6 +65,9 @@ typedef struct
   gboolean           pending_activation_timeout_waiting_finger_off;
 
   gint               bz3_threshold;
+  gint               max_minutiae;
+
+  GPtrArray         *identify_remaining;
 } FpImageDevicePrivate;
 
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (FpImageDevice, fp_image_device, FP_TYPE_DEVICE)
@@ -302,6 +311,7 @@ fp_image_device_finalize (GObject *object)
 
   g_assert (priv->active == FALSE);
   g_clear_handle_id (&priv->pending_activation_timeout_id, g_source_remove);
+  g_clear_pointer (&priv->identify_remaining, g_ptr_array_unref);
 
   G_OBJECT_CLASS (fp_image_device_parent_class)->finalize (object);
 }
@@ -392,6 +402,9 @@ fp_image_device_init (FpImageDevice *self)
   if (cls->bz3_threshold > 0)
     priv->bz3_threshold = cls->bz3_threshold;
 
+  /* 0 keeps as many minutiae as the matcher can handle */
+  priv->max_minutiae = cls->max_minutiae;
+
 }
 
 static void
@@ -411,33 +424,66 @@ fp_image_device_enroll_maybe_await_finger_on (FpImageDevice *self)
 }
 
 static void
-fpi_image_device_minutiae_detected (GObject *source_object, GAsyncResult *res, gpointer user_data)
+fpi_image_device_identify_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
-  g_autoptr(FpImage) image = FP_IMAGE (source_object);
-  g_autoptr(FpPrint) print = NULL;
-  GError *error = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GPtrArray) remaining = NULL;
+  FpPrint *print = FP_PRINT (source_object);
   FpDevice *device = FP_DEVICE (user_data);
-  FpImageDevicePrivate *priv;
-  FpDeviceAction action;
+  FpImageDevicePrivate *priv = fp_image_device_get_instance_private (FP_IMAGE_DEVICE (device));
+  FpPrint *result;
 
-  /* Note: We rely on the device to not disappear during an operation. */
+  result = fpi_print_bz3_identify_finish (print, res, &error);
+  remaining = g_steal_pointer (&priv->identify_remaining);
 
-  if (!fp_image_detect_minutiae_finish (image, res, &error))
+  /* The action has already been completed by the cancel handler. */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+
+  /* None of the likely candidates of the gallery matched, so compare the
+   * rest of it too rather than missing a print the index ranked low. */
+  if (!result && !error && remaining)
     {
-      /* Cancel operation . */
-      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-        {
-          fpi_device_action_error (device, g_steal_pointer (&error));
-          fp_image_device_deactivate (device);
-          return;
-        }
+      fpi_print_bz3_identify (print, remaining, priv->bz3_threshold,
+                              fpi_device_get_cancellable (device),
+                              fpi_image_device_identify_cb,
+                              device);
+      return;
+    }
 
-      /* Replace error with a retry condition. */
-      g_warning ("Failed to detect minutiae: %s", error->message);
-      g_clear_pointer (&error, g_error_free);
+  fpi_device_identify_complete (device, result, g_object_ref (print),
+                                g_steal_pointer (&error));
+  fp_image_device_deactivate (device);
+}
 
-      error = fpi_device_retry_new_msg (FP_DEVICE_RETRY_GENERAL, "Minutiae detection failed, please retry");
-    }
+static void
+fpi_image_device_identify_ranked_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  g_autoptr(GError) error = NULL;
+  FpPrint *print = FP_PRINT (source_object);
+  FpDevice *device = FP_DEVICE (user_data);
+  GPtrArray *candidates;
+
+  candidates = fpi_print_bz3_identify_ranked_finish (print, res, &error);
+
+  /* The action has already been completed by the cancel handler. */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+
+  fpi_device_identify_ranked_complete (device, candidates, g_object_ref (print),
+                                       g_steal_pointer (&error));
+  fp_image_device_deactivate (device);
+}
+
+/* Completes the scan of @image, turning it into a print unless @error
+ * already says that the user needs to retry. Takes ownership of both. */
+static void
+fp_image_device_image_scanned (FpDevice *device, FpImage *image_in, GError *error)
+{
+  g_autoptr(FpImage) image = image_in;
+  g_autoptr(FpPrint) print = NULL;
+  FpImageDevicePrivate *priv;
+  FpDeviceAction action;
 
   priv = fp_image_device_get_instance_private (FP_IMAGE_DEVICE (device));
   action = fpi_device_get_current_action (device);
@@ -453,7 +499,7 @@ fpi_image_device_minutiae_detected (GObject *source_object, GAsyncResult *res, g
     {
       print = fp_print_new (device);
       fpi_print_set_type (print, FP_PRINT_NBIS);
-      if (!fpi_print_add_from_image (print, image, &error))
+      if (!fpi_print_add_from_image (print, image, priv->max_minutiae, &error))
         g_clear_object (&print);
     }
 
@@ -498,24 +544,41 @@ fpi_image_device_minutiae_detected (GObject *source_object, GAsyncResult *res, g
     }
   else if (action == FP_DEVICE_ACTION_IDENTIFY)
     {
-      gint i;
+      g_autoptr(GPtrArray) candidates = NULL;
+      FpPrintGallery *gallery;
       GPtrArray *templates;
-      FpPrint *result = NULL;
+      guint max_results;
 
-      fpi_device_get_identify_data (device, &templates);
-      for (i = 0; !error && i < templates->len; i++)
+      if (!print)
         {
-          FpPrint *template = g_ptr_array_index (templates, i);
-
-          if (fpi_print_bz3_match (template, print, priv->bz3_threshold, &error) == FPI_MATCH_SUCCESS)
-            {
-              result = g_object_ref (template);
-              break;
-            }
+          fpi_device_identify_complete (device, NULL, NULL, error);
+          fp_image_device_deactivate (device);
+          return;
         }
 
-      fpi_device_identify_complete (device, result, g_steal_pointer (&print), error);
-      fp_image_device_deactivate (device);
+      /* Matching against a large gallery is expensive, search it in
+       * worker threads and complete the action once done. */
+      fpi_device_get_identify_data (device, &templates);
+      max_results = fpi_device_get_identify_max_results (device);
+
+      /* Compare against the likely candidates of a prepared gallery first,
+       * the gallery itself may have changed since the operation started. */
+      g_clear_pointer (&priv->identify_remaining, g_ptr_array_unref);
+      gallery = fpi_device_get_identify_gallery (device);
+      if (gallery)
+        templates = candidates = fpi_print_gallery_get_candidates (gallery, templates, print,
+                                                                   &priv->identify_remaining);
+      if (max_results > 0)
+        fpi_print_bz3_identify_ranked (print, templates, priv->bz3_threshold,
+                                       max_results,
+                                       fpi_device_get_cancellable (device),
+                                       fpi_image_device_identify_ranked_cb,
+                                       device);
+      else
+        fpi_print_bz3_identify (print, templates, priv->bz3_threshold,
+                                fpi_device_get_cancellable (device),
+                                fpi_image_device_identify_cb,
+                                device);
     }
   else
     {
@@ -529,6 +592,62 @@ fpi_image_device_minutiae_detected (GObject *source_object, GAsyncResult *res, g
     }
 }
 
+static void
+fpi_image_device_minutiae_detected (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  FpImage *image = FP_IMAGE (source_object);
+  GError *error = NULL;
+  FpDevice *device = FP_DEVICE (user_data);
+
+  /* Note: We rely on the device to not disappear during an operation. */
+
+  if (!fp_image_detect_minutiae_finish (image, res, &error))
+    {
+      /* Cancel operation . */
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_object_unref (image);
+          fpi_device_action_error (device, g_steal_pointer (&error));
+          fp_image_device_deactivate (device);
+          return;
+        }
+
+      /* Replace error with a retry condition. */
+      g_warning ("Failed to detect minutiae: %s", error->message);
+      g_clear_pointer (&error, g_error_free);
+
+      error = fpi_device_retry_new_msg (FP_DEVICE_RETRY_GENERAL, "Minutiae detection failed, please retry");
+    }
+
+  fp_image_device_image_scanned (device, image, error);
+}
+
+/* Rejects captures that cannot possibly give a usable print, so that the
+ * user is asked to retry right away instead of after the minutiae
+ * detection. The limits are loose on purpose, borderline images are
+ * left for the detection and the matching to judge. */
+static GError *
+fp_image_device_check_image_quality (FpImage *image)
+{
+  gdouble foreground;
+
+  foreground = fpi_image_get_foreground_ratio (image);
+  if (foreground >= MIN_FOREGROUND_RATIO)
+    return NULL;
+
+  g_debug ("Only %.0f%% of the image contains ridges, rejecting it",
+           foreground * 100);
+
+  /* A flat image means nothing usable was on the sensor, otherwise the
+   * print only covers a small part of it. */
+  if (fpi_std_sq_dev (image->data, image->width * image->height) <= MAX_BLANK_SQ_DEV)
+    return fpi_device_retry_new_msg (FP_DEVICE_RETRY_GENERAL,
+                                     "The scanned image is empty or smudged, please retry");
+
+  return fpi_device_retry_new_msg (FP_DEVICE_RETRY_CENTER_FINGER,
+                                   "Only a small part of the finger was scanned, please center it and retry");
+}
+
 /*********************************************************/
 /* Private API */
 
@@ -647,12 +766,25 @@ fpi_image_device_image_captured (FpImageDevice *self, FpImage *image)
 
   g_debug ("Image device captured an image");
 
+  /* The caller asked for the image itself, so do not judge it */
+  if (action != FP_DEVICE_ACTION_CAPTURE)
+    {
+      GError *error = fp_image_device_check_image_quality (image);
+
+      if (error)
+        {
+          fp_image_device_image_scanned (FP_DEVICE (self), image, error);
+          return;
+        }
+    }
+
   /* XXX: We also detect minutiae in capture mode, we solely do this
-   *      to normalize the image which will happen as a by-product. */
-  fp_image_detect_minutiae (image,
-                            fpi_device_get_cancellable (FP_DEVICE (self)),
-                            fpi_image_device_minutiae_detected,
-                            self);
+   *      to normalize the image which will happen as a by-product.
+   *      Prints only hold XYT data, so skip anything else. */
+  fpi_image_detect_minutiae_xyt (image,
+                                 fpi_device_get_cancellable (FP_DEVICE (self)),
+                                 fpi_image_device_minutiae_detected,
+                                 self);
 }
 
 /**
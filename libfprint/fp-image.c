@@ -51,6 +51,7 @@ enum {
   PROP_0,
   PROP_WIDTH,
   PROP_HEIGHT,
+  PROP_DETECTION_TIMINGS,
   N_PROPS
 };
 
@@ -73,6 +74,7 @@ fp_image_finalize (GObject *object)
   g_clear_pointer (&self->data, g_free);
   g_clear_pointer (&self->binarized, g_free);
   g_clear_pointer (&self->minutiae, g_ptr_array_unref);
+  g_clear_pointer (&self->detection_timings, g_variant_unref);
 
   G_OBJECT_CLASS (fp_image_parent_class)->finalize (object);
 }
@@ -103,6 +105,10 @@ fp_image_get_property (GObject    *object,
       g_value_set_uint (value, self->height);
       break;
 
+    case PROP_DETECTION_TIMINGS:
+      g_value_set_variant (value, self->detection_timings);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     }
@@ -159,6 +165,21 @@ fp_image_class_init (FpImageClass *klass)
                        0,
                        G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
 
+  /**
+   * FpImage:detection-timings:
+   *
+   * The time in seconds that the last minutiae detection spent in each
+   * of its stages, as a dictionary of type `a{sd}`. The stages are named
+   * after the NBIS routines, with "total" holding the overall time.
+   */
+  properties[PROP_DETECTION_TIMINGS] =
+    g_param_spec_variant ("detection-timings",
+                          "Detection timings",
+                          "The time spent in each stage of the minutiae detection",
+                          G_VARIANT_TYPE ("a{sd}"),
+                          NULL,
+                          G_PARAM_STATIC_STRINGS | G_PARAM_READABLE);
+
   g_object_class_install_properties (object_class, N_PROPS, properties);
 }
 
@@ -174,8 +195,10 @@ typedef struct
   gint                width, height;
   gdouble             ppmm;
   FpiImageFlags       flags;
+  gint                profile;
   guchar             *image;
   guchar             *binarized;
+  GVariant           *timings;
 } DetectMinutiaeData;
 
 static void
@@ -184,6 +207,7 @@ fp_image_detect_minutiae_free (DetectMinutiaeData *data)
   g_clear_pointer (&data->image, g_free);
   g_clear_pointer (&data->minutiae, free_minutiae);
   g_clear_pointer (&data->binarized, g_free);
+  g_clear_pointer (&data->timings, g_variant_unref);
   g_free (data);
 }
 
@@ -221,6 +245,10 @@ fp_image_detect_minutiae_cb (GObject      *source_object,
 
       /* Don't let it delete anything. */
       data->minutiae->num = 0;
+
+      g_clear_pointer (&image->detection_timings, g_variant_unref);
+      image->detection_timings = g_steal_pointer (&data->timings);
+      g_object_notify_by_pspec (G_OBJECT (image), properties[PROP_DETECTION_TIMINGS]);
     }
 
   if (data->user_cb)
@@ -276,6 +304,20 @@ invert_colors (guint8 *data, gint width, gint height)
     data[i] = 0xff - data[i];
 }
 
+static GVariant *
+build_detection_timings (const LFSTIMINGS *timings, gdouble total)
+{
+  GVariantBuilder builder;
+  gint i;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sd}"));
+  for (i = 0; i < NUM_LFS_STAGES; i++)
+    g_variant_builder_add (&builder, "{sd}", g_lfs_stage_names[i], timings->stages[i]);
+  g_variant_builder_add (&builder, "{sd}", "total", total);
+
+  return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
 static void
 fp_image_detect_minutiae_thread_func (GTask        *task,
                                       gpointer      source_object,
@@ -291,6 +333,10 @@ fp_image_detect_minutiae_thread_func (GTask        *task,
   g_autofree gint *high_curve_map = NULL;
   g_autofree gint *quality_map = NULL;
   g_autofree guchar *bdata = NULL;
+  g_autofree gchar *timings_str = NULL;
+  LFSPARMS lfsparms = g_lfsparms_V2;
+  LFSTIMINGS timings = { 0 };
+  LFSTIMINGS *prev_timings;
   gint map_w, map_h;
   gint bw, bh, bd;
   gint r;
@@ -307,14 +353,23 @@ fp_image_detect_minutiae_thread_func (GTask        *task,
 
   data->flags &= ~(FPI_IMAGE_H_FLIPPED | FPI_IMAGE_V_FLIPPED | FPI_IMAGE_COLORS_INVERTED);
 
+  lfsparms.fixed_point = MINDTCT_FIXED_POINT;
+  lfsparms.profile = data->profile;
+
+  prev_timings = set_lfs_timings (&timings);
   timer = g_timer_new ();
   r = get_minutiae (&minutiae, &quality_map, &direction_map,
                     &low_contrast_map, &low_flow_map, &high_curve_map,
                     &map_w, &map_h, &bdata, &bw, &bh, &bd,
                     data->image, data->width, data->height, 8,
-                    data->ppmm, &g_lfsparms_V2);
+                    data->ppmm, &lfsparms);
   g_timer_stop (timer);
+  set_lfs_timings (prev_timings);
+
+  data->timings = build_detection_timings (&timings, g_timer_elapsed (timer, NULL));
+  timings_str = g_variant_print (data->timings, FALSE);
   fp_dbg ("Minutiae scan completed in %f secs", g_timer_elapsed (timer, NULL));
+  fp_dbg ("Minutiae scan stage timings: %s", timings_str);
 
   data->binarized = g_steal_pointer (&bdata);
   data->minutiae = minutiae;
@@ -430,19 +485,28 @@ fp_image_get_minutiae (FpImage *self)
 }
 
 /**
- * fp_image_detect_minutiae:
+ * fp_image_get_detection_timings:
  * @self: A #FpImage
- * @cancellable: a #GCancellable, or %NULL
- * @callback: the function to call on completion
- * @user_data: the data to pass to @callback
  *
- * Detects the minutiae found in an image.
+ * Gets the time spent in each stage of the last minutiae detection, see
+ * #FpImage:detection-timings. You need to first detect the minutiae using
+ * fp_image_detect_minutiae().
+ *
+ * Returns: (transfer none) (nullable): A dictionary of type `a{sd}`, or
+ *   %NULL if no minutiae were detected yet
  */
-void
-fp_image_detect_minutiae (FpImage            *self,
-                          GCancellable       *cancellable,
-                          GAsyncReadyCallback callback,
-                          gpointer            user_data)
+GVariant *
+fp_image_get_detection_timings (FpImage *self)
+{
+  return self->detection_timings;
+}
+
+static void
+detect_minutiae (FpImage            *self,
+                 gint                profile,
+                 GCancellable       *cancellable,
+                 GAsyncReadyCallback callback,
+                 gpointer            user_data)
 {
   GTask *task;
   DetectMinutiaeData *data = g_new0 (DetectMinutiaeData, 1);
@@ -455,12 +519,31 @@ fp_image_detect_minutiae (FpImage            *self,
   data->width = self->width;
   data->height = self->height;
   data->ppmm = self->ppmm;
+  data->profile = profile;
   data->user_cb = callback;
 
   g_task_set_task_data (task, data, (GDestroyNotify) fp_image_detect_minutiae_free);
   g_task_run_in_thread (task, fp_image_detect_minutiae_thread_func);
 }
 
+/**
+ * fp_image_detect_minutiae:
+ * @self: A #FpImage
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Detects the minutiae found in an image.
+ */
+void
+fp_image_detect_minutiae (FpImage            *self,
+                          GCancellable       *cancellable,
+                          GAsyncReadyCallback callback,
+                          gpointer            user_data)
+{
+  detect_minutiae (self, LFS_PROFILE_FULL, cancellable, callback, user_data);
+}
+
 /**
  * fp_image_detect_minutiae_finish:
  * @self: A #FpImage
@@ -481,6 +564,75 @@ fp_image_detect_minutiae_finish (FpImage      *self,
 
 
 
+/**
+ * fpi_image_detect_minutiae_xyt:
+ * @self: A #FpImage
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Detects the minutiae found in an image, like fp_image_detect_minutiae(),
+ * but only determines what is needed to create a #FP_PRINT_NBIS print from
+ * them. Neighbours and ridge counts are not available for the minutiae.
+ * Finish the detection with fp_image_detect_minutiae_finish().
+ */
+void
+fpi_image_detect_minutiae_xyt (FpImage            *self,
+                               GCancellable       *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer            user_data)
+{
+  detect_minutiae (self, LFS_PROFILE_XYT, cancellable, callback, user_data);
+}
+
+/**
+ * fpi_image_get_foreground_ratio:
+ * @self: A #FpImage
+ *
+ * Estimates how much of the image is covered by a print, using the same
+ * contrast test that the minutiae detection uses to mask out the
+ * background. This only takes a single pass over the pixels, so it is
+ * cheap enough to reject a blank, smudged or partial capture before
+ * running the full detection on it.
+ *
+ * Returns: the fraction of the image blocks that contain ridges, between
+ *   0.0 and 1.0; or 1.0 if the image is too small to be judged
+ */
+gdouble
+fpi_image_get_foreground_ratio (FpImage *self)
+{
+  const LFSPARMS *lfsparms = &g_lfsparms_V2;
+  gint blocksize = lfsparms->windowsize;
+  g_autofree guint8 *block = NULL;
+  gint blocks = 0, foreground = 0;
+  gint bx, by, x, y;
+
+  g_return_val_if_fail (self != NULL, 0.0);
+
+  if (self->width < blocksize || self->height < blocksize)
+    return 1.0;
+
+  /* low_contrast_block() works on 6 bit pixels */
+  block = g_malloc (blocksize * blocksize);
+
+  for (by = 0; by + blocksize <= self->height; by += blocksize)
+    {
+      for (bx = 0; bx + blocksize <= self->width; bx += blocksize)
+        {
+          for (y = 0; y < blocksize; y++)
+            for (x = 0; x < blocksize; x++)
+              block[y * blocksize + x] = self->data[(by + y) * self->width + bx + x] >> 2;
+
+          /* Errors only happen for invalid parameters, count them as background */
+          if (low_contrast_block (0, blocksize, block, blocksize, blocksize, lfsparms) == FALSE)
+            foreground++;
+          blocks++;
+        }
+    }
+
+  return (gdouble) foreground / blocks;
+}
+
 /**
  * fpi_std_sq_dev:
  * @buf: buffer (usually bitmap, one byte per pixel)
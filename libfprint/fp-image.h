@@ -51,6 +51,7 @@ const guchar * fp_image_get_data (FpImage *self,
                                   gsize   *len);
 const guchar * fp_image_get_binarized (FpImage *self,
                                        gsize   *len);
+GVariant *     fp_image_get_detection_timings (FpImage *self);
 
 void           fp_minutia_get_coords (FpMinutia *min,
                                       gint      *x,
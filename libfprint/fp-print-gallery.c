@@ -0,0 +1,308 @@
+/*
+ * FpPrintGallery - A set of prints prepared for identification
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define FP_COMPONENT "print-gallery"
+#include "fpi-log.h"
+
+#include "fpi-print.h"
+#include "fpi-print-index.h"
+#include "fp-print-gallery.h"
+
+/**
+ * SECTION: fp-print-gallery
+ * @title: FpPrintGallery
+ * @short_description: Prints prepared for identification
+ *
+ * A #FpPrintGallery holds the set of enrolled prints to identify against
+ * with fp_device_identify_gallery(). All the data the matcher derives from
+ * a print, the pruned comparison table of its minutiae and its index entry,
+ * is computed once when it is added to the gallery, rather than on every
+ * identification, so long running services should keep a gallery around
+ * instead of passing a new list of prints for each operation.
+ *
+ * Large galleries are additionally indexed, so that the most promising
+ * prints are compared first and the rest only if none of them matches.
+ */
+
+/* Smaller galleries are always searched completely */
+#define GALLERY_INDEX_MIN_PRINTS 256
+/* Minimum and relative number of prints to compare after an index lookup */
+#define GALLERY_INDEX_MIN_CANDIDATES 64
+#define GALLERY_INDEX_CANDIDATES_DIVISOR 32
+
+struct _FpPrintGallery
+{
+  GObject        parent_instance;
+
+  GPtrArray     *prints;
+  FpiPrintIndex *index;
+};
+
+G_DEFINE_TYPE (FpPrintGallery, fp_print_gallery, G_TYPE_OBJECT)
+
+static void
+fp_print_gallery_finalize (GObject *object)
+{
+  FpPrintGallery *self = (FpPrintGallery *) object;
+
+  g_clear_pointer (&self->index, fpi_print_index_free);
+  g_clear_pointer (&self->prints, g_ptr_array_unref);
+
+  G_OBJECT_CLASS (fp_print_gallery_parent_class)->finalize (object);
+}
+
+static void
+fp_print_gallery_class_init (FpPrintGalleryClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = fp_print_gallery_finalize;
+}
+
+static void
+fp_print_gallery_init (FpPrintGallery *self)
+{
+  self->prints = g_ptr_array_new_with_free_func (g_object_unref);
+  self->index = fpi_print_index_new ();
+}
+
+/**
+ * fp_print_gallery_new:
+ *
+ * Create a new, empty #FpPrintGallery.
+ *
+ * Returns: (transfer full): A newly created #FpPrintGallery
+ */
+FpPrintGallery *
+fp_print_gallery_new (void)
+{
+  return g_object_new (FP_TYPE_PRINT_GALLERY, NULL);
+}
+
+/**
+ * fp_print_gallery_add:
+ * @gallery: A #FpPrintGallery
+ * @print: (transfer floating): The #FpPrint to add
+ *
+ * Adds @print to @gallery and prepares it for matching. This is the
+ * expensive part, so prints should be added once when loading them and
+ * not before every identification.
+ *
+ * Returns: %FALSE if @print is already part of @gallery
+ */
+gboolean
+fp_print_gallery_add (FpPrintGallery *gallery,
+                      FpPrint        *print)
+{
+  g_return_val_if_fail (FP_IS_PRINT_GALLERY (gallery), FALSE);
+  g_return_val_if_fail (FP_IS_PRINT (print), FALSE);
+
+  g_object_ref_sink (print);
+
+  if (g_ptr_array_find (gallery->prints, print, NULL))
+    {
+      g_object_unref (print);
+      return FALSE;
+    }
+
+  g_ptr_array_add (gallery->prints, print);
+
+  fpi_print_bz3_prepare (print);
+  fpi_print_index_add (gallery->index, print);
+
+  return TRUE;
+}
+
+/**
+ * fp_print_gallery_remove:
+ * @gallery: A #FpPrintGallery
+ * @print: The #FpPrint to remove
+ *
+ * Removes @print from @gallery, e.g. because it was deleted.
+ *
+ * Returns: %FALSE if @print was not part of @gallery
+ */
+gboolean
+fp_print_gallery_remove (FpPrintGallery *gallery,
+                         FpPrint        *print)
+{
+  g_return_val_if_fail (FP_IS_PRINT_GALLERY (gallery), FALSE);
+  g_return_val_if_fail (FP_IS_PRINT (print), FALSE);
+
+  fpi_print_index_remove (gallery->index, print);
+
+  return g_ptr_array_remove (gallery->prints, print);
+}
+
+/**
+ * fp_print_gallery_lookup:
+ * @gallery: A #FpPrintGallery
+ * @print: A #FpPrint
+ *
+ * Finds the print in @gallery that is equal to @print as defined by
+ * fp_print_equal(). This is useful to find the gallery entry for e.g. a
+ * print that was loaded from disk again.
+ *
+ * Returns: (transfer none) (nullable): The #FpPrint from @gallery, or %NULL
+ */
+FpPrint *
+fp_print_gallery_lookup (FpPrintGallery *gallery,
+                         FpPrint        *print)
+{
+  gint i;
+
+  g_return_val_if_fail (FP_IS_PRINT_GALLERY (gallery), NULL);
+  g_return_val_if_fail (FP_IS_PRINT (print), NULL);
+
+  for (i = 0; i < gallery->prints->len; i++)
+    {
+      FpPrint *entry = g_ptr_array_index (gallery->prints, i);
+
+      if (entry == print || fp_print_equal (entry, print))
+        return entry;
+    }
+
+  return NULL;
+}
+
+/**
+ * fp_print_gallery_get_n_prints:
+ * @gallery: A #FpPrintGallery
+ *
+ * Returns: The number of prints in @gallery
+ */
+guint
+fp_print_gallery_get_n_prints (FpPrintGallery *gallery)
+{
+  g_return_val_if_fail (FP_IS_PRINT_GALLERY (gallery), 0);
+
+  return gallery->prints->len;
+}
+
+/**
+ * fp_print_gallery_get_prints:
+ * @gallery: A #FpPrintGallery
+ *
+ * Get the prints in @gallery, in the order they were added. The array
+ * must not be modified and is only valid until @gallery is changed.
+ *
+ * Returns: (transfer none) (element-type FpPrint): The prints of @gallery
+ */
+GPtrArray *
+fp_print_gallery_get_prints (FpPrintGallery *gallery)
+{
+  g_return_val_if_fail (FP_IS_PRINT_GALLERY (gallery), NULL);
+
+  return gallery->prints;
+}
+
+/**
+ * fpi_print_gallery_get_candidates:
+ * @gallery: A #FpPrintGallery
+ * @prints: (element-type FpPrint): The prints of @gallery when the
+ *   identification started, see fpi_device_get_identify_data()
+ * @probe: A newly scanned #FpPrint
+ * @remaining: (out) (transfer full) (element-type FpPrint) (nullable): The
+ *   other prints of @prints, or %NULL if all of them are candidates
+ *
+ * Get the prints of @prints that are worth comparing against @probe.
+ * For small galleries this is all of @prints, otherwise the index of
+ * @gallery is used to select the most likely matches. Prints that are not
+ * indexed (anymore) are always included. Prints that were added to
+ * @gallery after @prints was taken are never returned.
+ *
+ * The index may rank a genuine print too low, so @remaining needs to be
+ * compared as well if none of the candidates matches.
+ *
+ * Returns: (transfer full) (element-type FpPrint): The candidate prints
+ */
+GPtrArray *
+fpi_print_gallery_get_candidates (FpPrintGallery *gallery,
+                                  GPtrArray      *prints,
+                                  FpPrint        *probe,
+                                  GPtrArray     **remaining)
+{
+  g_autoptr(GHashTable) snapshot = NULL;
+  g_autoptr(GHashTable) selected = NULL;
+  g_autoptr(GPtrArray) indexed = NULL;
+  GPtrArray *candidates;
+  GPtrArray *others;
+  guint max_candidates;
+  guint n_indexed = 0;
+  gint i;
+
+  g_return_val_if_fail (FP_IS_PRINT_GALLERY (gallery), NULL);
+  g_return_val_if_fail (prints != NULL, NULL);
+  g_return_val_if_fail (remaining != NULL, NULL);
+
+  *remaining = NULL;
+
+  if (prints->len < GALLERY_INDEX_MIN_PRINTS ||
+      !fpi_print_get_nbis_prints (probe))
+    return g_ptr_array_ref (prints);
+
+  snapshot = g_hash_table_new (NULL, NULL);
+  for (i = 0; i < prints->len; i++)
+    {
+      FpPrint *print = g_ptr_array_index (prints, i);
+
+      g_hash_table_add (snapshot, print);
+      if (fpi_print_index_contains (gallery->index, print))
+        n_indexed += 1;
+    }
+
+  /* The index follows the changes to the gallery, leave room for the
+   * prints that were added since and filter them out again. */
+  max_candidates = MAX (GALLERY_INDEX_MIN_CANDIDATES,
+                        prints->len / GALLERY_INDEX_CANDIDATES_DIVISOR);
+  max_candidates += fpi_print_index_get_n_prints (gallery->index) - n_indexed;
+  indexed = fpi_print_index_query (gallery->index, probe, max_candidates);
+
+  selected = g_hash_table_new (NULL, NULL);
+  candidates = g_ptr_array_new_full (indexed->len, g_object_unref);
+  for (i = 0; i < indexed->len; i++)
+    {
+      FpPrint *print = g_ptr_array_index (indexed, i);
+
+      if (g_hash_table_contains (snapshot, print))
+        {
+          g_hash_table_add (selected, print);
+          g_ptr_array_add (candidates, g_object_ref (print));
+        }
+    }
+
+  others = g_ptr_array_new_full (prints->len - candidates->len, g_object_unref);
+  for (i = 0; i < prints->len; i++)
+    {
+      FpPrint *print = g_ptr_array_index (prints, i);
+
+      if (!fpi_print_index_contains (gallery->index, print))
+        g_ptr_array_add (candidates, g_object_ref (print));
+      else if (!g_hash_table_contains (selected, print))
+        g_ptr_array_add (others, g_object_ref (print));
+    }
+
+  fp_dbg ("Comparing %u of %u gallery prints first", candidates->len, prints->len);
+
+  if (others->len > 0)
+    *remaining = others;
+  else
+    g_ptr_array_unref (others);
+
+  return candidates;
+}
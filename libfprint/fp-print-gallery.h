@@ -0,0 +1,40 @@
+/*
+ * FpPrintGallery - A set of prints prepared for identification
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#pragma once
+
+#include "fp-print.h"
+
+G_BEGIN_DECLS
+
+#define FP_TYPE_PRINT_GALLERY (fp_print_gallery_get_type ())
+G_DECLARE_FINAL_TYPE (FpPrintGallery, fp_print_gallery, FP, PRINT_GALLERY, GObject)
+
+FpPrintGallery *fp_print_gallery_new (void);
+
+gboolean        fp_print_gallery_add (FpPrintGallery *gallery,
+                                      FpPrint        *print);
+gboolean        fp_print_gallery_remove (FpPrintGallery *gallery,
+                                         FpPrint        *print);
+FpPrint        *fp_print_gallery_lookup (FpPrintGallery *gallery,
+                                         FpPrint        *print);
+
+guint           fp_print_gallery_get_n_prints (FpPrintGallery *gallery);
+GPtrArray      *fp_print_gallery_get_prints (FpPrintGallery *gallery);
+
+G_END_DECLS
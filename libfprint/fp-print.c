@@ -62,10 +62,28 @@ struct _FpPrint
 
   GVariant  *data;
   GPtrArray *prints;
+
+  /* Lazily built bozorth3 gallery webs, one per entry in prints */
+  GPtrArray *bz3_webs;
 };
 
 G_DEFINE_TYPE (FpPrint, fp_print, G_TYPE_INITIALLY_UNOWNED)
 
+struct _FpMatchCandidate
+{
+  gint     ref_count;
+
+  FpPrint *print;
+  gint     score;
+  gboolean is_match;
+};
+
+G_DEFINE_BOXED_TYPE (FpMatchCandidate, fp_match_candidate, fp_match_candidate_ref, fp_match_candidate_unref)
+
+/* The bozorth3 working tables are big, so only allocate them once per
+ * thread that does matching and keep them around until the thread exits. */
+static GPrivate bz_match_context_key = G_PRIVATE_INIT ((GDestroyNotify) bz_match_context_free);
+
 enum {
   PROP_0,
   PROP_DRIVER,
@@ -102,6 +120,7 @@ fp_print_finalize (GObject *object)
   g_clear_pointer (&self->enroll_date, g_date_free);
   g_clear_pointer (&self->data, g_variant_unref);
   g_clear_pointer (&self->prints, g_ptr_array_unref);
+  g_clear_pointer (&self->bz3_webs, g_ptr_array_unref);
 
   G_OBJECT_CLASS (fp_print_parent_class)->finalize (object);
 }
@@ -542,6 +561,14 @@ fp_print_set_enroll_date (FpPrint     *print,
 
 
 
+static void
+fpi_print_append_xyt (FpPrint *print, struct xyt_struct *xyt)
+{
+  g_ptr_array_add (print->prints, xyt);
+  /* Built on first use, see fpi_print_get_bz3_web() */
+  g_ptr_array_add (print->bz3_webs, NULL);
+}
+
 /**
  * fpi_print_add_print:
  * @print: A #FpPrint
@@ -558,7 +585,7 @@ fpi_print_add_print (FpPrint *print, FpPrint *add)
   g_return_if_fail (add->type == FP_PRINT_NBIS);
 
   g_assert (add->prints->len == 1);
-  g_ptr_array_add (print->prints, g_memdup (add->prints->pdata[0], sizeof (struct xyt_struct)));
+  fpi_print_append_xyt (print, g_memdup (add->prints->pdata[0], sizeof (struct xyt_struct)));
 }
 
 /**
@@ -583,6 +610,7 @@ fpi_print_set_type (FpPrint    *print,
     {
       g_assert_null (print->prints);
       print->prints = g_ptr_array_new_with_free_func (g_free);
+      print->bz3_webs = g_ptr_array_new_with_free_func ((GDestroyNotify) bozorth_gallery_web_free);
     }
   g_object_notify_by_pspec (G_OBJECT (print), properties[PROP_FPI_TYPE]);
 }
@@ -605,25 +633,50 @@ fpi_print_set_device_stored (FpPrint *print,
   g_object_notify_by_pspec (G_OBJECT (print), properties[PROP_DEVICE_STORED]);
 }
 
-/* XXX: This is the old version, but wouldn't it be smarter to instead
- * use the highest quality mintutiae? Possibly just using bz_prune from
- * upstream? */
+static gint
+compare_minutiae_reliability (gconstpointer a, gconstpointer b)
+{
+  const struct fp_minutia *ma = *(const struct fp_minutia **) a;
+  const struct fp_minutia *mb = *(const struct fp_minutia **) b;
+
+  /* Most reliable first; the sort is stable, so detection order decides
+   * between minutiae of equal reliability. */
+  if (ma->reliability > mb->reliability)
+    return -1;
+  if (ma->reliability < mb->reliability)
+    return 1;
+  return 0;
+}
+
+/* Like bz_prune from upstream, only the @max_minutiae most reliable minutiae
+ * are kept. Matching time grows quadratically with their number, and the
+ * least reliable ones are mostly noise that does not help matching. */
 static void
 minutiae_to_xyt (struct fp_minutiae *minutiae,
                  int                 bwidth,
                  int                 bheight,
+                 int                 max_minutiae,
                  struct xyt_struct  *xyt)
 {
   int i;
   struct fp_minutia *minutia;
-  struct minutiae_struct c[MAX_FILE_MINUTIAE];
+  struct minutiae_struct c[MAX_BOZORTH_MINUTIAE];
+  g_autofree struct fp_minutia **ranked = NULL;
+  int nmin;
 
   /* struct xyt_struct uses arrays of MAX_BOZORTH_MINUTIAE (200) */
-  int nmin = min (minutiae->num, MAX_BOZORTH_MINUTIAE);
+  if (max_minutiae <= 0 || max_minutiae > MAX_BOZORTH_MINUTIAE)
+    max_minutiae = MAX_BOZORTH_MINUTIAE;
+  nmin = min (minutiae->num, max_minutiae);
+
+  ranked = g_memdup (minutiae->list, minutiae->num * sizeof (struct fp_minutia *));
+  if (nmin < minutiae->num)
+    g_qsort_with_data (ranked, minutiae->num, sizeof (struct fp_minutia *),
+                       (GCompareDataFunc) compare_minutiae_reliability, NULL);
 
   for (i = 0; i < nmin; i++)
     {
-      minutia = minutiae->list[i];
+      minutia = ranked[i];
 
       lfs2nist_minutia_XYT (&c[i].col[0], &c[i].col[1], &c[i].col[2],
                             minutia, bwidth, bheight);
@@ -649,10 +702,12 @@ minutiae_to_xyt (struct fp_minutiae *minutiae,
  * fpi_print_add_from_image:
  * @print: A #FpPrint
  * @image: A #FpImage
+ * @max_minutiae: Maximum number of minutiae to keep, or 0 for the default
  * @error: Return location for error
  *
  * Extracts the minutiae from the given image and adds it to @print of
- * type #FP_PRINT_NBIS.
+ * type #FP_PRINT_NBIS. If more than @max_minutiae minutiae were detected,
+ * only the most reliable ones are used.
  *
  * The @image will be kept so that API users can get retrieve it e.g.
  * for debugging purposes.
@@ -662,6 +717,7 @@ minutiae_to_xyt (struct fp_minutiae *minutiae,
 gboolean
 fpi_print_add_from_image (FpPrint *print,
                           FpImage *image,
+                          gint     max_minutiae,
                           GError **error)
 {
   GPtrArray *minutiae;
@@ -692,8 +748,8 @@ fpi_print_add_from_image (FpPrint *print,
   _minutiae.alloc = minutiae->len;
 
   xyt = g_new0 (struct xyt_struct, 1);
-  minutiae_to_xyt (&_minutiae, image->width, image->height, xyt);
-  g_ptr_array_add (print->prints, xyt);
+  minutiae_to_xyt (&_minutiae, image->width, image->height, max_minutiae, xyt);
+  fpi_print_append_xyt (print, xyt);
 
   g_clear_object (&print->image);
   print->image = g_object_ref (image);
@@ -702,6 +758,152 @@ fpi_print_add_from_image (FpPrint *print,
   return TRUE;
 }
 
+/**
+ * fpi_print_get_nbis_prints:
+ * @print: A #FpPrint
+ *
+ * Get the minutiae of a #FP_PRINT_NBIS print, there is one entry for each
+ * scan that was added to @print.
+ *
+ * Returns: (transfer none) (nullable) (element-type struct xyt_struct): The
+ *   minutiae, or %NULL if @print is not of type #FP_PRINT_NBIS
+ */
+GPtrArray *
+fpi_print_get_nbis_prints (FpPrint *print)
+{
+  g_return_val_if_fail (FP_IS_PRINT (print), NULL);
+
+  if (print->type != FP_PRINT_NBIS)
+    return NULL;
+
+  return print->prints;
+}
+
+static BzMatchContext *
+fpi_print_get_bz_match_context (void)
+{
+  BzMatchContext *ctx = g_private_get (&bz_match_context_key);
+
+  if (!ctx)
+    {
+      ctx = bz_match_context_new ();
+      g_private_set (&bz_match_context_key, ctx);
+    }
+
+  return ctx;
+}
+
+static struct bz_gallery_web *
+fpi_print_get_bz3_web (BzMatchContext *ctx, FpPrint *print, guint i)
+{
+  gpointer *web_ptr = &g_ptr_array_index (print->bz3_webs, i);
+  struct bz_gallery_web *web;
+
+  web = g_atomic_pointer_get (web_ptr);
+  if (web)
+    return web;
+
+  /* The web only depends on the enrolled minutiae, so build it once and
+   * keep it with the print. Several threads may race to do this for the
+   * same template; only the first one to finish gets to store it. */
+  web = bozorth_gallery_web_new (ctx, g_ptr_array_index (print->prints, i));
+  if (!g_atomic_pointer_compare_and_exchange (web_ptr, NULL, web))
+    {
+      bozorth_gallery_web_free (web);
+      web = g_atomic_pointer_get (web_ptr);
+    }
+
+  return web;
+}
+
+/**
+ * fpi_print_bz3_prepare:
+ * @print: An enrolled #FpPrint
+ *
+ * Precompute the data the matcher derives from @print, which would otherwise
+ * be done the first time @print is matched against. Does nothing for prints
+ * that are not of type #FP_PRINT_NBIS.
+ */
+void
+fpi_print_bz3_prepare (FpPrint *print)
+{
+  BzMatchContext *ctx;
+  gint i;
+
+  g_return_if_fail (FP_IS_PRINT (print));
+
+  if (print->type != FP_PRINT_NBIS)
+    return;
+
+  ctx = fpi_print_get_bz_match_context ();
+  for (i = 0; i < print->prints->len; i++)
+    fpi_print_get_bz3_web (ctx, print, i);
+}
+
+/* Returns the best score of @template, or -1 on error. Scoring stops early
+ * once a print of @template reaches @stop_score, and each print is only
+ * scored as far as needed to know whether it reaches @stop_score. Scores
+ * below @stop_score are then not exact, pass G_MAXINT to get full scores. */
+static gint
+fpi_print_bz3_score_probe (BzMatchContext    *ctx,
+                           gint               probe_len,
+                           struct xyt_struct *pstruct,
+                           FpPrint           *template,
+                           gint               stop_score,
+                           GError           **error)
+{
+  gint best_score = 0;
+  gint i;
+
+  if (template->type != FP_PRINT_NBIS)
+    {
+      g_propagate_error (error,
+                         fpi_device_error_new_msg (FP_DEVICE_ERROR_NOT_SUPPORTED,
+                                                   "It is only possible to match NBIS type print data"));
+      return -1;
+    }
+
+  for (i = 0; i < template->prints->len; i++)
+    {
+      struct xyt_struct *gstruct;
+      gint score;
+      gstruct = g_ptr_array_index (template->prints, i);
+      score = bozorth_to_gallery_web (ctx, probe_len, pstruct, gstruct,
+                                      fpi_print_get_bz3_web (ctx, template, i),
+                                      stop_score != G_MAXINT ? stop_score : 0);
+      fp_dbg ("score %d", score);
+
+      best_score = MAX (best_score, score);
+      if (best_score >= stop_score)
+        break;
+    }
+
+  return best_score;
+}
+
+static gboolean
+fpi_print_check_probe (FpPrint *print, GError **error)
+{
+  /* XXX: Use a different error type? */
+  if (print->type != FP_PRINT_NBIS)
+    {
+      g_propagate_error (error,
+                         fpi_device_error_new_msg (FP_DEVICE_ERROR_NOT_SUPPORTED,
+                                                   "It is only possible to match NBIS type print data"));
+      return FALSE;
+    }
+
+  if (print->prints->len != 1)
+    {
+      g_propagate_error (error,
+                         fpi_device_error_new_msg (FP_DEVICE_ERROR_GENERAL,
+                                                   "New print contains more than one print!"));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
 /**
  * fpi_print_bz3_match:
  * @template: A #FpPrint containing one or more prints
@@ -715,46 +917,510 @@ fpi_print_add_from_image (FpPrint *print,
  * Both @template and @print need to be of type #FP_PRINT_NBIS for this to
  * work.
  *
+ * This function is thread-safe, the matcher state is kept per thread.
+ *
  * Returns: Whether the prints match, @error will be set if #FPI_MATCH_ERROR is returned
  */
 FpiMatchResult
 fpi_print_bz3_match (FpPrint *template, FpPrint *print, gint bz3_threshold, GError **error)
 {
+  BzMatchContext *ctx;
   struct xyt_struct *pstruct;
   gint probe_len;
+  gint score;
+
+  if (!fpi_print_check_probe (print, error))
+    return FPI_MATCH_ERROR;
+
+  ctx = fpi_print_get_bz_match_context ();
+  pstruct = g_ptr_array_index (print->prints, 0);
+  probe_len = bozorth_probe_init (ctx, pstruct);
+
+  score = fpi_print_bz3_score_probe (ctx, probe_len, pstruct,
+                                     template, bz3_threshold, error);
+  if (score < 0)
+    return FPI_MATCH_ERROR;
+
+  return score >= bz3_threshold ? FPI_MATCH_SUCCESS : FPI_MATCH_FAIL;
+}
+
+typedef enum {
+  IDENTIFY_MODE_FIRST_MATCH,
+  IDENTIFY_MODE_RANKED,
+  IDENTIFY_MODE_ALL_SCORES,
+} IdentifyMode;
+
+typedef struct
+{
+  GPtrArray   *templates;
+  gint         bz3_threshold;
+  IdentifyMode mode;
+
+  /* Only set when scoring every template, the best score of each */
+  guint        max_results;
+  gint        *scores;
+
+  /* Accessed atomically by the workers */
+  gint       next_template;
+  gint       match_index;
+  gint       workers_running;
+
+  GMutex     error_lock;
+  GError    *error;
+} IdentifyData;
+
+static void
+identify_data_free (IdentifyData *data)
+{
+  g_ptr_array_unref (data->templates);
+  g_free (data->scores);
+  g_mutex_clear (&data->error_lock);
+  g_clear_error (&data->error);
+  g_free (data);
+}
+
+static gint
+identify_data_compare_ranks (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  IdentifyData *data = user_data;
+  gint idx_a = *(const gint *) a;
+  gint idx_b = *(const gint *) b;
+
+  /* Higher scores first, the gallery order decides between equal scores */
+  if (data->scores[idx_a] != data->scores[idx_b])
+    return data->scores[idx_b] - data->scores[idx_a];
+
+  return idx_a - idx_b;
+}
+
+static GPtrArray *
+identify_data_get_candidates (IdentifyData *data)
+{
+  g_autofree gint *ranks = NULL;
+  GPtrArray *candidates;
+  guint n_candidates;
   gint i;
 
-  /* XXX: Use a different error type? */
-  if (template->type != FP_PRINT_NBIS || print->type != FP_PRINT_NBIS)
-    {
-      *error = fpi_device_error_new_msg (FP_DEVICE_ERROR_NOT_SUPPORTED,
-                                         "It is only possible to match NBIS type print data");
-      return FPI_MATCH_ERROR;
-    }
+  ranks = g_new (gint, data->templates->len);
+  for (i = 0; i < data->templates->len; i++)
+    ranks[i] = i;
 
-  if (print->prints->len != 1)
+  /* All scores are returned in the order of the templates */
+  if (data->mode == IDENTIFY_MODE_RANKED)
+    g_qsort_with_data (ranks, data->templates->len, sizeof (gint),
+                       identify_data_compare_ranks, data);
+
+  n_candidates = MIN (data->max_results, data->templates->len);
+  candidates = g_ptr_array_new_full (n_candidates,
+                                     (GDestroyNotify) fp_match_candidate_unref);
+  for (i = 0; i < n_candidates; i++)
     {
-      *error = fpi_device_error_new_msg (FP_DEVICE_ERROR_GENERAL,
-                                         "New print contains more than one print!");
-      return FPI_MATCH_ERROR;
+      gint score = data->scores[ranks[i]];
+
+      g_ptr_array_add (candidates,
+                       fpi_match_candidate_new (g_ptr_array_index (data->templates, ranks[i]),
+                                                score,
+                                                score >= data->bz3_threshold));
     }
 
+  return candidates;
+}
+
+static void
+fpi_print_bz3_identify_worker (gpointer task_ptr,
+                               gpointer user_data)
+{
+  GTask *task = task_ptr;
+  FpPrint *print = g_task_get_source_object (task);
+  IdentifyData *data = g_task_get_task_data (task);
+  GCancellable *cancellable = g_task_get_cancellable (task);
+  BzMatchContext *ctx;
+  struct xyt_struct *pstruct;
+  gint stop_score;
+  gint probe_len;
+
+  /* Each worker prepares the probe web in its own thread context and then
+   * grabs templates from the shared gallery until it is exhausted, an error
+   * happens or a match was found at a lower index than the next candidate.
+   * A ranked search needs every score, so it never stops at a match. */
+  ctx = fpi_print_get_bz_match_context ();
   pstruct = g_ptr_array_index (print->prints, 0);
-  probe_len = bozorth_probe_init (pstruct);
+  probe_len = bozorth_probe_init (ctx, pstruct);
+  stop_score = data->scores ? G_MAXINT : data->bz3_threshold;
 
-  for (i = 0; i < template->prints->len; i++)
+  while (TRUE)
     {
-      struct xyt_struct *gstruct;
+      g_autoptr(GError) error = NULL;
       gint score;
-      gstruct = g_ptr_array_index (template->prints, i);
-      score = bozorth_to_gallery (probe_len, pstruct, gstruct);
-      fp_dbg ("score %d", score);
+      gint i;
+
+      i = g_atomic_int_add (&data->next_template, 1);
+      if (i >= (gint) data->templates->len ||
+          i > g_atomic_int_get (&data->match_index))
+        break;
+
+      if (g_cancellable_is_cancelled (cancellable))
+        break;
+
+      score = fpi_print_bz3_score_probe (ctx, probe_len, pstruct,
+                                         g_ptr_array_index (data->templates, i),
+                                         stop_score, &error);
+
+      if (score < 0)
+        {
+          g_mutex_lock (&data->error_lock);
+          if (!data->error)
+            data->error = g_steal_pointer (&error);
+          g_mutex_unlock (&data->error_lock);
+
+          /* Make all workers stop */
+          g_atomic_int_set (&data->match_index, -1);
+          break;
+        }
+
+      if (data->scores)
+        {
+          data->scores[i] = score;
+        }
+      else if (score >= data->bz3_threshold)
+        {
+          gint match_index;
+
+          /* Keep the lowest matching index so that the result does not
+           * depend on the scheduling of the workers. */
+          do
+            match_index = g_atomic_int_get (&data->match_index);
+          while (i < match_index &&
+                 !g_atomic_int_compare_and_exchange (&data->match_index, match_index, i));
+        }
+    }
+
+  if (!g_atomic_int_dec_and_test (&data->workers_running))
+    return;
+
+  /* Last worker to finish reports the result */
+  if (data->error)
+    g_task_return_error (task, g_steal_pointer (&data->error));
+  else if (g_task_return_error_if_cancelled (task))
+    ;
+  else if (data->scores)
+    g_task_return_pointer (task,
+                           identify_data_get_candidates (data),
+                           (GDestroyNotify) g_ptr_array_unref);
+  else
+    g_task_return_pointer (task,
+                           data->match_index < data->templates->len ?
+                           g_object_ref (g_ptr_array_index (data->templates, data->match_index)) :
+                           NULL,
+                           g_object_unref);
+
+  g_object_unref (task);
+}
+
+static GThreadPool *
+fpi_print_get_identify_pool (void)
+{
+  static gsize pool_initialized = 0;
+  static GThreadPool *pool = NULL;
+
+  if (g_once_init_enter (&pool_initialized))
+    {
+      pool = g_thread_pool_new (fpi_print_bz3_identify_worker,
+                                NULL,
+                                g_get_num_processors (),
+                                FALSE,
+                                NULL);
+      g_once_init_leave (&pool_initialized, 1);
+    }
+
+  return pool;
+}
+
+static void
+fpi_print_bz3_identify_start (FpPrint            *print,
+                              GPtrArray          *templates,
+                              gint                bz3_threshold,
+                              IdentifyMode        mode,
+                              guint               max_results,
+                              GCancellable       *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer            user_data,
+                              gpointer            source_tag)
+{
+  GTask *task;
+  IdentifyData *data;
+  GError *error = NULL;
+  gint n_workers;
+  gint i;
+
+  task = g_task_new (print, cancellable, callback, user_data);
+  g_task_set_source_tag (task, source_tag);
+
+  if (!fpi_print_check_probe (print, &error))
+    {
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
 
-      if (score >= bz3_threshold)
-        return FPI_MATCH_SUCCESS;
+  if (templates->len == 0 || (mode != IDENTIFY_MODE_FIRST_MATCH && max_results == 0))
+    {
+      if (mode != IDENTIFY_MODE_FIRST_MATCH)
+        g_task_return_pointer (task,
+                               g_ptr_array_new_with_free_func ((GDestroyNotify) fp_match_candidate_unref),
+                               (GDestroyNotify) g_ptr_array_unref);
+      else
+        g_task_return_pointer (task, NULL, NULL);
+      g_object_unref (task);
+      return;
     }
 
-  return FPI_MATCH_FAIL;
+  n_workers = MIN (g_get_num_processors (), templates->len);
+
+  data = g_new0 (IdentifyData, 1);
+  data->templates = g_ptr_array_ref (templates);
+  data->bz3_threshold = bz3_threshold;
+  data->mode = mode;
+  data->match_index = G_MAXINT;
+  data->workers_running = n_workers;
+  g_mutex_init (&data->error_lock);
+  if (mode != IDENTIFY_MODE_FIRST_MATCH)
+    {
+      data->max_results = max_results;
+      data->scores = g_new0 (gint, templates->len);
+    }
+  g_task_set_task_data (task, data, (GDestroyNotify) identify_data_free);
+
+  /* The task reference is dropped by the last worker */
+  for (i = 0; i < n_workers; i++)
+    g_thread_pool_push (fpi_print_get_identify_pool (), task, NULL);
+}
+
+/**
+ * fpi_print_bz3_identify:
+ * @print: A newly scanned #FpPrint to search for
+ * @templates: (element-type FpPrint): The #FpPrint gallery to search
+ * @bz3_threshold: The BZ3 match threshold
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Search @templates for the first print that matches @print. The gallery is
+ * spread across a pool of worker threads (one per CPU), and the search stops
+ * early as soon as a match is found or @cancellable is triggered.
+ *
+ * The @callback is invoked in the thread-default main context of the caller
+ * and @print is its source object. Use fpi_print_bz3_identify_finish() to
+ * retrieve the result.
+ */
+void
+fpi_print_bz3_identify (FpPrint            *print,
+                        GPtrArray          *templates,
+                        gint                bz3_threshold,
+                        GCancellable       *cancellable,
+                        GAsyncReadyCallback callback,
+                        gpointer            user_data)
+{
+  g_return_if_fail (FP_IS_PRINT (print));
+  g_return_if_fail (templates != NULL);
+
+  fpi_print_bz3_identify_start (print, templates, bz3_threshold,
+                                IDENTIFY_MODE_FIRST_MATCH, 0,
+                                cancellable, callback, user_data,
+                                fpi_print_bz3_identify);
+}
+
+/**
+ * fpi_print_bz3_identify_finish:
+ * @print: The #FpPrint that was searched for
+ * @res: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finish an identify operation started with fpi_print_bz3_identify().
+ * A %NULL return value without @error being set means that no print
+ * in the gallery matched.
+ *
+ * Returns: (transfer full) (nullable): The matching #FpPrint from the gallery
+ */
+FpPrint *
+fpi_print_bz3_identify_finish (FpPrint      *print,
+                               GAsyncResult *res,
+                               GError      **error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, print), NULL);
+
+  return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/**
+ * fpi_print_bz3_identify_ranked:
+ * @print: A newly scanned #FpPrint to search for
+ * @templates: (element-type FpPrint): The #FpPrint gallery to search
+ * @bz3_threshold: The BZ3 match threshold
+ * @max_results: The maximum number of candidates to return
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the function to call on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Like fpi_print_bz3_identify(), but scores every print in @templates in
+ * a single pass and returns the @max_results best candidates. Candidates
+ * scoring below @bz3_threshold are included, but not flagged as a match.
+ *
+ * Use fpi_print_bz3_identify_ranked_finish() to retrieve the result.
+ */
+void
+fpi_print_bz3_identify_ranked (FpPrint            *print,
+                               GPtrArray          *templates,
+                               gint                bz3_threshold,
+                               guint               max_results,
+                               GCancellable       *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer            user_data)
+{
+  g_return_if_fail (FP_IS_PRINT (print));
+  g_return_if_fail (templates != NULL);
+
+  fpi_print_bz3_identify_start (print, templates, bz3_threshold,
+                                IDENTIFY_MODE_RANKED, max_results,
+                                cancellable, callback, user_data,
+                                fpi_print_bz3_identify_ranked);
+}
+
+/**
+ * fpi_print_bz3_identify_ranked_finish:
+ * @print: The #FpPrint that was searched for
+ * @res: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finish an identify operation started with fpi_print_bz3_identify_ranked().
+ *
+ * Returns: (transfer full) (element-type FpMatchCandidate): The best
+ *   candidates, sorted by descending score, or %NULL on error
+ */
+GPtrArray *
+fpi_print_bz3_identify_ranked_finish (FpPrint      *print,
+                                      GAsyncResult *res,
+                                      GError      **error)
+{
+  g_return_val_if_fail (g_task_is_valid (res, print), NULL);
+
+  return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+match_batch_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  GAsyncResult **result = user_data;
+
+  *result = g_object_ref (res);
+}
+
+/**
+ * fp_print_match:
+ * @enrolled_print: An enrolled #FpPrint, e.g. loaded from storage
+ * @print: The #FpPrint to compare against @enrolled_print
+ * @threshold: The score at which the prints are considered a match
+ * @score: (out) (optional): Return location for the score, or %NULL
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Compares two prints without the need for a device. This works for prints
+ * that are matched by libfprint itself (e.g. those of image devices), which
+ * can also be deserialized ones. @print must contain a single scan, while
+ * @enrolled_print may contain any number of them.
+ *
+ * Devices use a driver specific @threshold, 40 is the default for image
+ * devices. Scoring stops once the result is known if @score is %NULL,
+ * otherwise the full score of the best matching scan is computed.
+ *
+ * This function is thread-safe and can be called concurrently for
+ * different prints.
+ *
+ * Returns: %TRUE if the prints match, %FALSE if they don't or on error
+ */
+gboolean
+fp_print_match (FpPrint *enrolled_print,
+                FpPrint *print,
+                gint     threshold,
+                gint    *score,
+                GError **error)
+{
+  BzMatchContext *ctx;
+  struct xyt_struct *pstruct;
+  gint probe_len;
+  gint best_score;
+
+  g_return_val_if_fail (FP_IS_PRINT (enrolled_print), FALSE);
+  g_return_val_if_fail (FP_IS_PRINT (print), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (!score)
+    return fpi_print_bz3_match (enrolled_print, print, threshold, error) == FPI_MATCH_SUCCESS;
+
+  *score = 0;
+  if (!fpi_print_check_probe (print, error))
+    return FALSE;
+
+  ctx = fpi_print_get_bz_match_context ();
+  pstruct = g_ptr_array_index (print->prints, 0);
+  probe_len = bozorth_probe_init (ctx, pstruct);
+
+  best_score = fpi_print_bz3_score_probe (ctx, probe_len, pstruct,
+                                          enrolled_print, G_MAXINT, error);
+  if (best_score < 0)
+    return FALSE;
+
+  *score = best_score;
+
+  return best_score >= threshold;
+}
+
+/**
+ * fp_print_match_batch:
+ * @print: The #FpPrint to compare against @enrolled_prints
+ * @enrolled_prints: (element-type FpPrint): Enrolled prints, e.g. loaded from
+ *   storage
+ * @threshold: The score at which prints are considered a match
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @error: Return location for errors, or %NULL to ignore
+ *
+ * Like fp_print_match(), but scores @print against every print in
+ * @enrolled_prints. The comparisons are spread across a pool of worker
+ * threads, which makes this considerably faster than calling
+ * fp_print_match() in a loop, e.g. to look for duplicates in a database.
+ *
+ * This function blocks until all prints are scored, it is thread-safe and
+ * does not use the thread-default main context.
+ *
+ * Returns: (transfer full) (element-type FpMatchCandidate): One candidate
+ *   for each of @enrolled_prints in the same order, or %NULL on error
+ */
+GPtrArray *
+fp_print_match_batch (FpPrint      *print,
+                      GPtrArray    *enrolled_prints,
+                      gint          threshold,
+                      GCancellable *cancellable,
+                      GError      **error)
+{
+  g_autoptr(GMainContext) context = NULL;
+  g_autoptr(GAsyncResult) res = NULL;
+
+  g_return_val_if_fail (FP_IS_PRINT (print), NULL);
+  g_return_val_if_fail (enrolled_prints != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  context = g_main_context_new ();
+  g_main_context_push_thread_default (context);
+
+  fpi_print_bz3_identify_start (print, enrolled_prints, threshold,
+                                IDENTIFY_MODE_ALL_SCORES, enrolled_prints->len,
+                                cancellable, match_batch_ready, &res,
+                                fp_print_match_batch);
+  while (!res)
+    g_main_context_iteration (context, TRUE);
+
+  g_main_context_pop_thread_default (context);
+
+  return g_task_propagate_pointer (G_TASK (res), error);
 }
 
 /**
@@ -1079,7 +1745,7 @@ fp_print_deserialize (const guchar *data,
           memcpy (xyt->ycol, ycol, sizeof (xcol[0]) * xlen);
           memcpy (xyt->thetacol, thetacol, sizeof (xcol[0]) * xlen);
 
-          g_ptr_array_add (result->prints, g_steal_pointer (&xyt));
+          fpi_print_append_xyt (result, g_steal_pointer (&xyt));
         }
     }
   else if (type == FP_PRINT_RAW)
@@ -1118,3 +1784,122 @@ invalid_format:
                                 "Data could not be parsed");
   return FALSE;
 }
+
+/**
+ * fpi_match_candidate_new:
+ * @print: The #FpPrint from the gallery
+ * @score: The matching score of @print
+ * @is_match: Whether @score is good enough to be considered a match
+ *
+ * Creates a new #FpMatchCandidate.
+ *
+ * Returns: (transfer full): A newly created #FpMatchCandidate
+ */
+FpMatchCandidate *
+fpi_match_candidate_new (FpPrint *print,
+                         gint     score,
+                         gboolean is_match)
+{
+  FpMatchCandidate *self;
+
+  g_return_val_if_fail (FP_IS_PRINT (print), NULL);
+
+  self = g_slice_new0 (FpMatchCandidate);
+  self->ref_count = 1;
+
+  self->print = g_object_ref (print);
+  self->score = score;
+  self->is_match = is_match;
+
+  return self;
+}
+
+/**
+ * fp_match_candidate_ref:
+ * @self: A #FpMatchCandidate
+ *
+ * Increments the reference count of @self by one.
+ *
+ * Returns: (transfer full): @self
+ */
+FpMatchCandidate *
+fp_match_candidate_ref (FpMatchCandidate *self)
+{
+  g_return_val_if_fail (self, NULL);
+  g_return_val_if_fail (self->ref_count, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+/**
+ * fp_match_candidate_unref:
+ * @self: A #FpMatchCandidate
+ *
+ * Decrements the reference count of @self by one, freeing the structure when
+ * the reference count reaches zero.
+ */
+void
+fp_match_candidate_unref (FpMatchCandidate *self)
+{
+  g_return_if_fail (self);
+  g_return_if_fail (self->ref_count);
+
+  if (!g_atomic_int_dec_and_test (&self->ref_count))
+    return;
+
+  g_clear_object (&self->print);
+  g_slice_free (FpMatchCandidate, self);
+}
+
+/**
+ * fp_match_candidate_get_print:
+ * @self: A #FpMatchCandidate
+ *
+ * Returns the print from the gallery that this candidate refers to.
+ *
+ * Returns: (transfer none): The #FpPrint
+ */
+FpPrint *
+fp_match_candidate_get_print (FpMatchCandidate *self)
+{
+  g_return_val_if_fail (self, NULL);
+
+  return self->print;
+}
+
+/**
+ * fp_match_candidate_get_score:
+ * @self: A #FpMatchCandidate
+ *
+ * Returns the raw matching score of the candidate. Scores are only
+ * comparable between results of the same driver. A score of -1 means
+ * that the device cannot report scores.
+ *
+ * Returns: The score
+ */
+gint
+fp_match_candidate_get_score (FpMatchCandidate *self)
+{
+  g_return_val_if_fail (self, -1);
+
+  return self->score;
+}
+
+/**
+ * fp_match_candidate_is_match:
+ * @self: A #FpMatchCandidate
+ *
+ * Whether the score of the candidate is high enough for the driver to
+ * consider it a match.
+ *
+ * Returns: %TRUE if the candidate is a match
+ */
+gboolean
+fp_match_candidate_is_match (FpMatchCandidate *self)
+{
+  g_return_val_if_fail (self, FALSE);
+
+  return self->is_match;
+}
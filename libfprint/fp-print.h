@@ -28,6 +28,9 @@ G_BEGIN_DECLS
 #define FP_TYPE_PRINT (fp_print_get_type ())
 G_DECLARE_FINAL_TYPE (FpPrint, fp_print, FP, PRINT, GInitiallyUnowned)
 
+#define FP_TYPE_MATCH_CANDIDATE (fp_match_candidate_get_type ())
+typedef struct _FpMatchCandidate FpMatchCandidate;
+
 #include "fp-device.h"
 
 /**
@@ -98,4 +101,24 @@ FpPrint *fp_print_deserialize (const guchar *data,
                                gsize         length,
                                GError      **error);
 
+gboolean   fp_print_match (FpPrint *enrolled_print,
+                           FpPrint *print,
+                           gint     threshold,
+                           gint    *score,
+                           GError **error);
+GPtrArray *fp_print_match_batch (FpPrint      *print,
+                                 GPtrArray    *enrolled_prints,
+                                 gint          threshold,
+                                 GCancellable *cancellable,
+                                 GError      **error);
+
+GType             fp_match_candidate_get_type (void) G_GNUC_CONST;
+FpMatchCandidate *fp_match_candidate_ref (FpMatchCandidate *self);
+void              fp_match_candidate_unref (FpMatchCandidate *self);
+FpPrint          *fp_match_candidate_get_print (FpMatchCandidate *self);
+gint              fp_match_candidate_get_score (FpMatchCandidate *self);
+gboolean          fp_match_candidate_is_match (FpMatchCandidate *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FpMatchCandidate, fp_match_candidate_unref)
+
 G_END_DECLS
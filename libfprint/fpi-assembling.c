@@ -27,6 +27,11 @@
 
 #include "fpi-assembling.h"
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define ASSEMBLING_X86_SIMD
+#include <emmintrin.h>
+#endif
+
 /**
  * SECTION:fpi-assembling
  * @title: Image frame assembly
@@ -38,48 +43,115 @@
  * data in small stripes.
  */
 
+/* The number of bytes between the start of two lines of the frame data */
+static unsigned int
+frame_line_stride (struct fpi_frame_asmbl_ctx *ctx)
+{
+  if (ctx->stride)
+    return ctx->stride;
+
+  return ((ctx->column_major ? ctx->frame_height : ctx->frame_width) *
+          ctx->bits_per_pixel + 7) / 8;
+}
+
+/* Copies the pixels of @frame into @buf, as rows of 8 bit pixels */
+static void
+unpack_frame (struct fpi_frame_asmbl_ctx *ctx,
+              struct fpi_frame           *frame,
+              unsigned char              *buf)
+{
+  unsigned int x, y, stride;
+
+  stride = frame_line_stride (ctx);
+
+  if (ctx->bits_per_pixel == 8 && !ctx->column_major)
+    {
+      for (y = 0; y < ctx->frame_height; y++)
+        memcpy (buf + y * ctx->frame_width, frame->data + y * stride,
+                ctx->frame_width);
+    }
+  else if (ctx->bits_per_pixel == 8)
+    {
+      for (x = 0; x < ctx->frame_width; x++)
+        for (y = 0; y < ctx->frame_height; y++)
+          buf[y * ctx->frame_width + x] = frame->data[x * stride + y];
+    }
+  else if (ctx->bits_per_pixel == 4)
+    {
+      for (y = 0; y < ctx->frame_height; y++)
+        for (x = 0; x < ctx->frame_width; x++)
+          {
+            unsigned int i = ctx->column_major ? y : x;
+            unsigned char v;
+
+            v = frame->data[(ctx->column_major ? x : y) * stride + i / 2];
+            v = i % 2 ? v >> 4 : v & 0xf;
+            buf[y * ctx->frame_width + x] = v * 17;
+          }
+    }
+  else
+    {
+      for (y = 0; y < ctx->frame_height; y++)
+        for (x = 0; x < ctx->frame_width; x++)
+          buf[y * ctx->frame_width + x] = ctx->get_pixel (ctx, frame, x, y);
+    }
+}
+
+/* Sum of absolute differences of two rows of pixels */
+static unsigned int
+row_error (const unsigned char *row1,
+           const unsigned char *row2,
+           unsigned int         width)
+{
+  unsigned int err = 0;
+  unsigned int i = 0;
+
+#ifdef ASSEMBLING_X86_SIMD
+  __m128i sum = _mm_setzero_si128 ();
+
+  for (; i + 16 <= width; i += 16)
+    sum = _mm_add_epi64 (sum,
+                         _mm_sad_epu8 (_mm_loadu_si128 ((const __m128i *) (row1 + i)),
+                                       _mm_loadu_si128 ((const __m128i *) (row2 + i))));
+  err = _mm_cvtsi128_si32 (sum) + _mm_cvtsi128_si32 (_mm_srli_si128 (sum, 8));
+#endif
+
+  for (; i < width; i++)
+    err += row1[i] > row2[i] ? row1[i] - row2[i] : row2[i] - row1[i];
+
+  return err;
+}
+
+/* Returns the error of a movement, normalized to the size of the frame.
+ * Once the error is known to reach @limit, @limit is returned right away.
+ */
 static unsigned int
 calc_error (struct fpi_frame_asmbl_ctx *ctx,
-            struct fpi_frame           *first_frame,
-            struct fpi_frame           *second_frame,
+            const unsigned char        *first_frame,
+            const unsigned char        *second_frame,
             int                         dx,
-            int                         dy)
+            int                         dy,
+            unsigned int                limit)
 {
   unsigned int width, height;
-  unsigned int x1, y1, x2, y2, err, i, j;
+  unsigned int x1, x2, err, i;
 
   width = ctx->frame_width - (dx > 0 ? dx : -dx);
   height = ctx->frame_height - dy;
 
-  y1 = 0;
-  y2 = dy;
-  i = 0;
+  x1 = dx < 0 ? 0 : dx;
+  x2 = dx < 0 ? -dx : 0;
   err = 0;
-  do
+  for (i = 0; i < height; i++)
     {
-      x1 = dx < 0 ? 0 : dx;
-      x2 = dx < 0 ? -dx : 0;
-      j = 0;
+      err += row_error (first_frame + i * ctx->frame_width + x1,
+                        second_frame + (i + dy) * ctx->frame_width + x2,
+                        width);
 
-      do
-        {
-          unsigned char v1, v2;
-
-
-          v1 = ctx->get_pixel (ctx, first_frame, x1, y1);
-          v2 = ctx->get_pixel (ctx, second_frame, x2, y2);
-          err += v1 > v2 ? v1 - v2 : v2 - v1;
-          j++;
-          x1++;
-          x2++;
-
-        }
-      while (j < width);
-      i++;
-      y1++;
-      y2++;
+      if (err > 0 &&
+          (guint64) err * ctx->frame_height * ctx->frame_width / (height * width) >= limit)
+        return limit;
     }
-  while (i < height);
 
   /* Normalize error */
   err *= (ctx->frame_height * ctx->frame_width);
@@ -91,82 +163,277 @@ calc_error (struct fpi_frame_asmbl_ctx *ctx,
   return err;
 }
 
+/* The range of movements between two frames that are searched */
+#define OVERLAP_DX_MIN -8
+#define OVERLAP_DX_MAX 8
+#define OVERLAP_DY_MIN 2
+/* How far the search around the previous movement goes in each direction */
+#define PREDICTION_RADIUS 2
+
+struct overlap_prediction
+{
+  gboolean     valid;
+  int          dx;
+  int          dy;
+  unsigned int error;
+};
+
+/* Searches the movement with the lowest error between two frames, among
+ * the horizontal offsets [dx_min, dx_max) and vertical ones [dy_min, dy_max).
+ * Returns FALSE if no offset has an error below @min_error.
+ */
+static gboolean
+search_overlap (struct fpi_frame_asmbl_ctx *ctx,
+                const unsigned char        *first_frame,
+                const unsigned char        *second_frame,
+                int                         dx_min,
+                int                         dx_max,
+                int                         dy_min,
+                int                         dy_max,
+                int                        *best_dx,
+                int                        *best_dy,
+                unsigned int               *min_error)
+{
+  gboolean found = FALSE;
+  gboolean early_exit;
+  int dx, dy;
+  unsigned int err;
+
+  /* The normalization of the error may overflow for large frames, in
+   * which case a partial error says nothing about the final one. */
+  early_exit = ctx->frame_width * ctx->frame_height <=
+               G_MAXUINT / 255 / (ctx->frame_width * ctx->frame_height);
+
+  for (dy = dy_min; dy < dy_max; dy++)
+    {
+      for (dx = dx_min; dx < dx_max; dx++)
+        {
+          err = calc_error (ctx, first_frame, second_frame, dx, dy,
+                            early_exit ? *min_error : G_MAXUINT);
+          if (err < *min_error)
+            {
+              *min_error = err;
+              *best_dx = dx;
+              *best_dy = dy;
+              found = TRUE;
+            }
+        }
+    }
+
+  return found;
+}
+
 /* This function is rather CPU-intensive. It's better to use hardware
  * to detect movement direction when possible.
  */
-static void
+static gboolean
 find_overlap (struct fpi_frame_asmbl_ctx *ctx,
-              struct fpi_frame           *first_frame,
-              struct fpi_frame           *second_frame,
+              const unsigned char        *first_frame,
+              const unsigned char        *second_frame,
+              struct overlap_prediction  *prediction,
+              int                        *dx,
+              int                        *dy,
               unsigned int               *min_error)
 {
-  int dx, dy;
-  unsigned int err;
-
   *min_error = 255 * ctx->frame_height * ctx->frame_width;
 
+  /* The finger speed only changes slowly between frames, so first look
+   * around the movement found for the previous pair. That result is only
+   * trusted if it is not at the edge of the window, and if its error is
+   * not above the previous one. Otherwise search everywhere.
+   */
+  if (prediction->valid)
+    {
+      int dx_min = MAX (prediction->dx - PREDICTION_RADIUS, OVERLAP_DX_MIN);
+      int dx_max = MIN (prediction->dx + PREDICTION_RADIUS + 1, OVERLAP_DX_MAX);
+      int dy_min = MAX (prediction->dy - PREDICTION_RADIUS, OVERLAP_DY_MIN);
+      int dy_max = MIN (prediction->dy + PREDICTION_RADIUS + 1, (int) ctx->frame_height);
+
+      if (search_overlap (ctx, first_frame, second_frame,
+                          dx_min, dx_max, dy_min, dy_max,
+                          dx, dy, min_error) &&
+          (*dx > dx_min || dx_min == OVERLAP_DX_MIN) &&
+          (*dx < dx_max - 1 || dx_max == OVERLAP_DX_MAX) &&
+          (*dy > dy_min || dy_min == OVERLAP_DY_MIN) &&
+          (*dy < dy_max - 1 || dy_max == ctx->frame_height) &&
+          *min_error <= prediction->error)
+        goto found;
+
+      /* The best movement of the window bounds the full search, which
+       * still returns the same movement as without the window. */
+      *min_error = MIN (*min_error + 1, 255 * ctx->frame_height * ctx->frame_width);
+    }
+
   /* Seeking in horizontal and vertical dimensions,
    * for horizontal dimension we'll check only 8 pixels
    * in both directions. For vertical direction diff is
    * rarely less than 2, so start with it.
    */
-  for (dy = 2; dy < ctx->frame_height; dy++)
+  if (!search_overlap (ctx, first_frame, second_frame,
+                       OVERLAP_DX_MIN, OVERLAP_DX_MAX,
+                       OVERLAP_DY_MIN, ctx->frame_height,
+                       dx, dy, min_error))
     {
-      for (dx = -8; dx < 8; dx++)
-        {
-          err = calc_error (ctx, first_frame, second_frame,
-                            dx, dy);
-          if (err < *min_error)
-            {
-              *min_error = err;
-              second_frame->delta_x = -dx;
-              second_frame->delta_y = dy;
-            }
-        }
+      prediction->valid = FALSE;
+      return FALSE;
     }
+
+found:
+  prediction->valid = TRUE;
+  prediction->dx = *dx;
+  prediction->dy = *dy;
+  prediction->error = *min_error;
+
+  return TRUE;
 }
 
-static unsigned int
-do_movement_estimation (struct fpi_frame_asmbl_ctx *ctx,
-                        GSList *stripes, gboolean reverse)
+/* The movements found between each pair of frames for one swipe direction */
+struct movement_estimation
 {
-  GSList *l;
-  GTimer *timer;
-  guint num_frames = 0;
-  struct fpi_frame *prev_stripe;
-  unsigned int min_error;
+  struct overlap_prediction prediction;
+  GArray                   *deltas;
   /* Max error is width * height * 255, for AES2501 which has the largest
    * sensor its 192*16*255 = 783360. So for 32bit value it's ~5482 frame before
    * we might get int overflow. Use 64bit value here to prevent integer overflow
    */
-  unsigned long long total_error = 0;
+  unsigned long long        total_error;
+};
 
-  timer = g_timer_new ();
-  prev_stripe = stripes->data;
-  for (l = stripes; l != NULL; l = l->next, num_frames++)
+/* Estimates the movements of both swipe directions as the frames come in,
+ * so every frame is only unpacked once. The overlap searches run on
+ * unpacked copies of the frames.
+ */
+struct movement_estimator
+{
+  struct fpi_frame_asmbl_ctx *ctx;
+  unsigned char              *prev_pixels;
+  unsigned char              *cur_pixels;
+  guint                       num_frames;
+  struct movement_estimation  forward;
+  struct movement_estimation  reverse;
+};
+
+static void
+estimate_pair (struct fpi_frame_asmbl_ctx *ctx,
+               const unsigned char        *first_frame,
+               const unsigned char        *second_frame,
+               struct movement_estimation *estimation)
+{
+  unsigned int min_error;
+  int delta[2];
+  int dx, dy;
+
+  if (!find_overlap (ctx, first_frame, second_frame,
+                     &estimation->prediction, &dx, &dy, &min_error))
+    dx = dy = 0;
+
+  delta[0] = -dx;
+  delta[1] = dy;
+  g_array_append_vals (estimation->deltas, delta, 2);
+  estimation->total_error += min_error;
+}
+
+static void
+movement_estimator_init (struct movement_estimator  *estimator,
+                         struct fpi_frame_asmbl_ctx *ctx)
+{
+  memset (estimator, 0, sizeof (*estimator));
+  estimator->ctx = ctx;
+  estimator->prev_pixels = g_malloc (ctx->frame_width * ctx->frame_height);
+  estimator->cur_pixels = g_malloc (ctx->frame_width * ctx->frame_height);
+  estimator->forward.deltas = g_array_new (FALSE, FALSE, sizeof (int));
+  estimator->reverse.deltas = g_array_new (FALSE, FALSE, sizeof (int));
+}
+
+static void
+movement_estimator_reset (struct movement_estimator *estimator)
+{
+  estimator->num_frames = 0;
+  estimator->forward.prediction.valid = FALSE;
+  estimator->forward.total_error = 0;
+  g_array_set_size (estimator->forward.deltas, 0);
+  estimator->reverse.prediction.valid = FALSE;
+  estimator->reverse.total_error = 0;
+  g_array_set_size (estimator->reverse.deltas, 0);
+}
+
+static void
+movement_estimator_clear (struct movement_estimator *estimator)
+{
+  g_clear_pointer (&estimator->prev_pixels, g_free);
+  g_clear_pointer (&estimator->cur_pixels, g_free);
+  g_clear_pointer (&estimator->forward.deltas, g_array_unref);
+  g_clear_pointer (&estimator->reverse.deltas, g_array_unref);
+}
+
+static void
+movement_estimator_add_frame (struct movement_estimator *estimator,
+                              struct fpi_frame          *frame)
+{
+  struct fpi_frame_asmbl_ctx *ctx = estimator->ctx;
+  unsigned char *tmp;
+
+  if (estimator->num_frames++ == 0)
     {
-      struct fpi_frame *cur_stripe = l->data;
+      unpack_frame (ctx, frame, estimator->prev_pixels);
+      return;
+    }
+
+  unpack_frame (ctx, frame, estimator->cur_pixels);
+
+  estimate_pair (ctx, estimator->cur_pixels, estimator->prev_pixels,
+                 &estimator->forward);
+  estimate_pair (ctx, estimator->prev_pixels, estimator->cur_pixels,
+                 &estimator->reverse);
+
+  tmp = estimator->prev_pixels;
+  estimator->prev_pixels = estimator->cur_pixels;
+  estimator->cur_pixels = tmp;
+}
 
-      if (reverse)
+/* Writes the deltas of the swipe direction with the lowest error to
+ * @stripes, which are the frames that were added, in the same order.
+ */
+static void
+movement_estimator_apply (struct movement_estimator *estimator,
+                          struct fpi_frame         **stripes)
+{
+  struct movement_estimation *forward = &estimator->forward;
+  struct movement_estimation *reverse = &estimator->reverse;
+  guint num_pairs = estimator->num_frames - 1;
+  struct fpi_frame *stripe;
+  guint pair;
+
+  fp_dbg ("errors: %llu rev: %llu",
+          num_pairs ? forward->total_error / num_pairs : 0,
+          num_pairs ? reverse->total_error / num_pairs : 0);
+
+  /* Going forward, each frame gets the movement to the next one. Going in
+   * reverse, each frame gets the movement from the previous one. */
+  if (forward->total_error < reverse->total_error)
+    {
+      for (pair = 0; pair < num_pairs; pair++)
         {
-          find_overlap (ctx, prev_stripe, cur_stripe, &min_error);
-          cur_stripe->delta_y = -cur_stripe->delta_y;
-          cur_stripe->delta_x = -cur_stripe->delta_x;
+          stripe = stripes[pair];
+          stripe->delta_x = g_array_index (forward->deltas, int, pair * 2);
+          stripe->delta_y = g_array_index (forward->deltas, int, pair * 2 + 1);
         }
-      else
+      stripe = stripes[num_pairs];
+    }
+  else
+    {
+      for (pair = 0; pair < num_pairs; pair++)
         {
-          find_overlap (ctx, cur_stripe, prev_stripe, &min_error);
+          stripe = stripes[pair + 1];
+          stripe->delta_x = -g_array_index (reverse->deltas, int, pair * 2);
+          stripe->delta_y = -g_array_index (reverse->deltas, int, pair * 2 + 1);
         }
-      total_error += min_error;
-
-      prev_stripe = cur_stripe;
+      stripe = stripes[0];
     }
 
-  g_timer_stop (timer);
-  fp_dbg ("calc delta completed in %f secs", g_timer_elapsed (timer, NULL));
-  g_timer_destroy (timer);
-
-  return total_error / num_frames;
+  /* The frame at the end of the movement has none */
+  stripe->delta_x = 0;
+  stripe->delta_y = 0;
 }
 
 /**
@@ -185,19 +452,36 @@ void
 fpi_do_movement_estimation (struct fpi_frame_asmbl_ctx *ctx,
                             GSList                     *stripes)
 {
-  int err, rev_err;
+  struct movement_estimator estimator;
+  g_autofree struct fpi_frame **frames = NULL;
+  GTimer *timer;
+  GSList *l;
+  guint i;
+
+  g_return_if_fail (stripes != NULL);
+
+  timer = g_timer_new ();
 
-  err = do_movement_estimation (ctx, stripes, FALSE);
-  rev_err = do_movement_estimation (ctx, stripes, TRUE);
-  fp_dbg ("errors: %d rev: %d", err, rev_err);
-  if (err < rev_err)
-    do_movement_estimation (ctx, stripes, FALSE);
+  frames = g_new (struct fpi_frame *, g_slist_length (stripes));
+  movement_estimator_init (&estimator, ctx);
+  for (l = stripes, i = 0; l != NULL; l = l->next, i++)
+    {
+      frames[i] = l->data;
+      movement_estimator_add_frame (&estimator, frames[i]);
+    }
+
+  g_timer_stop (timer);
+  fp_dbg ("calc delta completed in %f secs", g_timer_elapsed (timer, NULL));
+  g_timer_destroy (timer);
+
+  movement_estimator_apply (&estimator, frames);
+  movement_estimator_clear (&estimator);
 }
 
 static inline void
 aes_blit_stripe (struct fpi_frame_asmbl_ctx *ctx,
                  FpImage *img,
-                 struct fpi_frame *stripe,
+                 const unsigned char *pixels,
                  int x, int y)
 {
   unsigned int ix, iy;
@@ -260,43 +544,34 @@ aes_blit_stripe (struct fpi_frame_asmbl_ctx *ctx,
           ix = x;
           fx = 0;
         }
-      for (; fx < width; fx++, ix++)
-        img->data[ix + (iy * img->width)] = ctx->get_pixel (ctx, stripe, fx, fy);
+      if (fx < width)
+        memcpy (img->data + ix + (iy * img->width),
+                pixels + fx + (fy * ctx->frame_width), width - fx);
     }
 }
 
-/**
- * fpi_assemble_frames:
- * @ctx: #fpi_frame_asmbl_ctx - frame assembling context
- * @stripes: linked list of #fpi_frame
- *
- * fpi_assemble_frames() assembles individual frames into a single image.
- * It expects @delta_x and @delta_y of #fpi_frame to be populated.
- *
- * Returns: a newly allocated #fp_img.
- */
-FpImage *
-fpi_assemble_frames (struct fpi_frame_asmbl_ctx *ctx,
-                     GSList                     *stripes)
+static FpImage *
+assemble_frames (struct fpi_frame_asmbl_ctx *ctx,
+                 struct fpi_frame          **stripes,
+                 guint                       num_stripes)
 {
-  GSList *l;
   FpImage *img;
   int height = 0;
   int y, x;
   gboolean reverse = FALSE;
   struct fpi_frame *fpi_frame;
+  g_autofree unsigned char *pixels = NULL;
+  guint i;
 
-  //FIXME g_return_if_fail
-  g_return_val_if_fail (stripes != NULL, NULL);
   BUG_ON (ctx->image_width < ctx->frame_width);
 
   /* No offset for 1st image */
-  fpi_frame = stripes->data;
+  fpi_frame = stripes[0];
   fpi_frame->delta_x = 0;
   fpi_frame->delta_y = 0;
-  for (l = stripes; l != NULL; l = l->next)
+  for (i = 0; i < num_stripes; i++)
     {
-      fpi_frame = l->data;
+      fpi_frame = stripes[i];
 
       height += fpi_frame->delta_y;
     }
@@ -323,9 +598,12 @@ fpi_assemble_frames (struct fpi_frame_asmbl_ctx *ctx,
   y = reverse ? (height - ctx->frame_height) : 0;
   x = (ctx->image_width - ctx->frame_width) / 2;
 
-  for (l = stripes; l != NULL; l = l->next)
+  pixels = g_malloc (ctx->frame_width * ctx->frame_height);
+
+  for (i = 0; i < num_stripes; i++)
     {
-      fpi_frame = l->data;
+      fpi_frame = stripes[i];
+      unpack_frame (ctx, fpi_frame, pixels);
 
       if(reverse)
         {
@@ -333,7 +611,7 @@ fpi_assemble_frames (struct fpi_frame_asmbl_ctx *ctx,
           x += fpi_frame->delta_x;
         }
 
-      aes_blit_stripe (ctx, img, fpi_frame, x, y);
+      aes_blit_stripe (ctx, img, pixels, x, y);
 
       if(!reverse)
         {
@@ -345,6 +623,235 @@ fpi_assemble_frames (struct fpi_frame_asmbl_ctx *ctx,
   return img;
 }
 
+/**
+ * fpi_assemble_frames:
+ * @ctx: #fpi_frame_asmbl_ctx - frame assembling context
+ * @stripes: linked list of #fpi_frame
+ *
+ * fpi_assemble_frames() assembles individual frames into a single image.
+ * It expects @delta_x and @delta_y of #fpi_frame to be populated.
+ *
+ * Returns: a newly allocated #fp_img.
+ */
+FpImage *
+fpi_assemble_frames (struct fpi_frame_asmbl_ctx *ctx,
+                     GSList                     *stripes)
+{
+  g_autofree struct fpi_frame **frames = NULL;
+  GSList *l;
+  guint i;
+
+  //FIXME g_return_if_fail
+  g_return_val_if_fail (stripes != NULL, NULL);
+
+  frames = g_new (struct fpi_frame *, g_slist_length (stripes));
+  for (l = stripes, i = 0; l != NULL; l = l->next, i++)
+    frames[i] = l->data;
+
+  return assemble_frames (ctx, frames, i);
+}
+
+/* The frame buffer of an assembler starts with room for this many frames */
+#define FRAME_BUFFER_MIN_FRAMES 64
+
+struct _FpiFrameAssembler
+{
+  struct movement_estimator estimator;
+  gboolean                  estimate_movement;
+  /* The frames of the swipe, one after the other in a single buffer that
+   * is kept for the next swipes */
+  guint8                   *buffer;
+  gsize                     frame_size;
+  guint                     num_frames;
+  guint                     num_allocated;
+};
+
+static inline struct fpi_frame *
+assembler_frame (FpiFrameAssembler *assembler,
+                 guint              i)
+{
+  return (struct fpi_frame *) (assembler->buffer + i * assembler->frame_size);
+}
+
+/**
+ * fpi_frame_assembler_new:
+ * @ctx: #fpi_frame_asmbl_ctx - frame assembling context
+ * @estimate_movement: %FALSE if the device fills in the movement of
+ *   each frame, %TRUE to estimate it like fpi_do_movement_estimation()
+ *
+ * Creates a #FpiFrameAssembler, which keeps the frames of a swipe in a
+ * buffer that drivers fill in place and that is reused for every swipe.
+ * If needed, it also estimates the movement between the frames while they
+ * come in, rather than once the swipe is over.
+ *
+ * The size of the frames is given by the @bits_per_pixel, @stride and
+ * @column_major fields of @ctx, which needs to stay valid until the
+ * assembler is freed.
+ *
+ * Returns: (transfer full): a new #FpiFrameAssembler
+ */
+FpiFrameAssembler *
+fpi_frame_assembler_new (struct fpi_frame_asmbl_ctx *ctx,
+                         gboolean                    estimate_movement)
+{
+  FpiFrameAssembler *assembler;
+  gsize data_size;
+
+  g_return_val_if_fail (ctx != NULL, NULL);
+  g_return_val_if_fail (ctx->bits_per_pixel != 0, NULL);
+
+  assembler = g_new0 (FpiFrameAssembler, 1);
+  movement_estimator_init (&assembler->estimator, ctx);
+  assembler->estimate_movement = estimate_movement;
+
+  /* Keep the deltas of all the frames aligned */
+  data_size = (gsize) frame_line_stride (ctx) *
+              (ctx->column_major ? ctx->frame_width : ctx->frame_height);
+  assembler->frame_size = (sizeof (struct fpi_frame) + data_size +
+                           sizeof (int) - 1) / sizeof (int) * sizeof (int);
+
+  return assembler;
+}
+
+/**
+ * fpi_frame_assembler_free:
+ * @assembler: a #FpiFrameAssembler
+ *
+ * Frees @assembler and its frames.
+ */
+void
+fpi_frame_assembler_free (FpiFrameAssembler *assembler)
+{
+  if (!assembler)
+    return;
+
+  movement_estimator_clear (&assembler->estimator);
+  g_free (assembler->buffer);
+  g_free (assembler);
+}
+
+/**
+ * fpi_frame_assembler_get_next_frame:
+ * @assembler: a #FpiFrameAssembler
+ *
+ * Gets the place of the next frame of the swipe in the buffer of
+ * @assembler. Drivers should copy the frame data into it, along with the
+ * movement from the previous frame if the device reports it, and then call
+ * fpi_frame_assembler_add_frame(). The deltas of the frame are set to 0.
+ *
+ * The frame stays valid until the next call to this function, a frame
+ * that is never added is dropped.
+ *
+ * Returns: (transfer none): the next #fpi_frame
+ */
+struct fpi_frame *
+fpi_frame_assembler_get_next_frame (FpiFrameAssembler *assembler)
+{
+  struct fpi_frame *frame;
+
+  g_return_val_if_fail (assembler != NULL, NULL);
+
+  if (assembler->num_frames == assembler->num_allocated)
+    {
+      assembler->num_allocated = MAX (assembler->num_allocated * 2,
+                                       FRAME_BUFFER_MIN_FRAMES);
+      assembler->buffer = g_realloc (assembler->buffer,
+                                     assembler->num_allocated * assembler->frame_size);
+    }
+
+  frame = assembler_frame (assembler, assembler->num_frames);
+  frame->delta_x = 0;
+  frame->delta_y = 0;
+
+  return frame;
+}
+
+/**
+ * fpi_frame_assembler_add_frame:
+ * @assembler: a #FpiFrameAssembler
+ *
+ * Adds the frame returned by fpi_frame_assembler_get_next_frame() to the
+ * swipe, and estimates its movement from the previous one if needed.
+ * Drivers should call this as soon as they have read the frame from the
+ * device.
+ */
+void
+fpi_frame_assembler_add_frame (FpiFrameAssembler *assembler)
+{
+  g_return_if_fail (assembler != NULL);
+  g_return_if_fail (assembler->num_frames < assembler->num_allocated);
+
+  if (assembler->estimate_movement)
+    movement_estimator_add_frame (&assembler->estimator,
+                                  assembler_frame (assembler, assembler->num_frames));
+  assembler->num_frames++;
+}
+
+/**
+ * fpi_frame_assembler_get_n_frames:
+ * @assembler: a #FpiFrameAssembler
+ *
+ * Returns: the number of frames added since the last swipe
+ */
+guint
+fpi_frame_assembler_get_n_frames (FpiFrameAssembler *assembler)
+{
+  g_return_val_if_fail (assembler != NULL, 0);
+
+  return assembler->num_frames;
+}
+
+/**
+ * fpi_frame_assembler_finish:
+ * @assembler: a #FpiFrameAssembler
+ *
+ * Assembles the frames of the swipe into a single image, like
+ * fpi_assemble_frames() would, after fpi_do_movement_estimation() if the
+ * movement needs to be estimated. The assembler is then reset for the
+ * next swipe.
+ *
+ * Returns: (transfer full): a newly allocated #FpImage, or %NULL if no
+ *   frame was added
+ */
+FpImage *
+fpi_frame_assembler_finish (FpiFrameAssembler *assembler)
+{
+  g_autofree struct fpi_frame **frames = NULL;
+  FpImage *img;
+  guint i;
+
+  g_return_val_if_fail (assembler != NULL, NULL);
+  g_return_val_if_fail (assembler->num_frames > 0, NULL);
+
+  frames = g_new (struct fpi_frame *, assembler->num_frames);
+  for (i = 0; i < assembler->num_frames; i++)
+    frames[i] = assembler_frame (assembler, i);
+
+  if (assembler->estimate_movement)
+    movement_estimator_apply (&assembler->estimator, frames);
+  img = assemble_frames (assembler->estimator.ctx, frames, assembler->num_frames);
+
+  fpi_frame_assembler_reset (assembler);
+
+  return img;
+}
+
+/**
+ * fpi_frame_assembler_reset:
+ * @assembler: a #FpiFrameAssembler
+ *
+ * Drops the frames of the current swipe, for example when the capture
+ * is aborted.
+ */
+void
+fpi_frame_assembler_reset (FpiFrameAssembler *assembler)
+{
+  g_return_if_fail (assembler != NULL);
+
+  assembler->num_frames = 0;
+  movement_estimator_reset (&assembler->estimator);
+}
+
 static int
 cmpint (const void *p1, const void *p2, gpointer data)
 {
@@ -45,6 +45,12 @@ struct fpi_frame
  * @frame_height: height of the frame
  * @image_width: resulting image width
  * @get_pixel: pixel accessor, returns pixel brightness at x,y of frame
+ * @bits_per_pixel: size of a pixel in the frame data, either 4 or 8 bits;
+ *                  or 0 if the pixels can only be read through @get_pixel
+ * @stride: number of bytes between the start of two lines of the frame
+ *          data, 0 if the lines are tightly packed
+ * @column_major: whether the lines of the frame data are its columns
+ *                rather than its rows
  *
  * #fpi_frame_asmbl_ctx is a structure holding the context for frame
  * assembling routines.
@@ -52,6 +58,13 @@ struct fpi_frame
  * Drivers should define their own #fpi_frame_asmbl_ctx depending on
  * hardware parameters of scanner. @image_width is usually 25% wider than
  * @frame_width to take horizontal movement into account.
+ *
+ * If the frame data has a simple layout, drivers should also describe it
+ * using @bits_per_pixel, @stride and @column_major. The assembling
+ * routines then read the frames directly, which is a lot faster than
+ * calling @get_pixel for every pixel. With 4 bits per pixel, the first
+ * pixel of a byte is stored in its low nibble and the values are scaled
+ * to the full 8 bit range.
  */
 struct fpi_frame_asmbl_ctx
 {
@@ -62,6 +75,9 @@ struct fpi_frame_asmbl_ctx
                              struct fpi_frame           *frame,
                              unsigned int                x,
                              unsigned int                y);
+  unsigned int  bits_per_pixel;
+  unsigned int  stride;
+  gboolean      column_major;
 };
 
 void fpi_do_movement_estimation (struct fpi_frame_asmbl_ctx *ctx,
@@ -70,6 +86,26 @@ void fpi_do_movement_estimation (struct fpi_frame_asmbl_ctx *ctx,
 FpImage *fpi_assemble_frames (struct fpi_frame_asmbl_ctx *ctx,
                               GSList                     *stripes);
 
+/**
+ * FpiFrameAssembler:
+ *
+ * An opaque object assembling the frames of a swipe as they come in, see
+ * fpi_frame_assembler_new().
+ */
+typedef struct _FpiFrameAssembler FpiFrameAssembler;
+
+FpiFrameAssembler *fpi_frame_assembler_new (struct fpi_frame_asmbl_ctx *ctx,
+                                            gboolean                    estimate_movement);
+void               fpi_frame_assembler_free (FpiFrameAssembler *assembler);
+
+struct fpi_frame  *fpi_frame_assembler_get_next_frame (FpiFrameAssembler *assembler);
+void               fpi_frame_assembler_add_frame (FpiFrameAssembler *assembler);
+guint              fpi_frame_assembler_get_n_frames (FpiFrameAssembler *assembler);
+FpImage           *fpi_frame_assembler_finish (FpiFrameAssembler *assembler);
+void               fpi_frame_assembler_reset (FpiFrameAssembler *assembler);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FpiFrameAssembler, fpi_frame_assembler_free)
+
 /**
  * fpi_line_asmbl_ctx:
  * @line_width: width of line
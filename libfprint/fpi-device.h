@@ -198,6 +198,8 @@ void fpi_device_get_verify_data (FpDevice *device,
                                  FpPrint **print);
 void fpi_device_get_identify_data (FpDevice   *device,
                                    GPtrArray **prints);
+FpPrintGallery *fpi_device_get_identify_gallery (FpDevice *device);
+guint fpi_device_get_identify_max_results (FpDevice *device);
 void fpi_device_get_delete_data (FpDevice *device,
                                  FpPrint **print);
 GCancellable *fpi_device_get_cancellable (FpDevice *device);
@@ -237,6 +239,10 @@ void fpi_device_identify_complete (FpDevice *device,
                                    FpPrint  *match,
                                    FpPrint  *print,
                                    GError   *error);
+void fpi_device_identify_ranked_complete (FpDevice  *device,
+                                          GPtrArray *candidates,
+                                          FpPrint   *print,
+                                          GError    *error);
 void fpi_device_capture_complete (FpDevice *device,
                                   FpImage  *image,
                                   GError   *error);
@@ -46,6 +46,9 @@ typedef enum {
 /**
  * FpImageDeviceClass:
  * @bz3_threshold: Threshold to consider bozorth3 score a match, default: 40
+ * @max_minutiae: Maximum number of minutiae to keep in a print, the least
+ *   reliable ones are dropped first. Lowering it makes noisy sensors produce
+ *   smaller templates that are faster to match, default: 200
  * @img_width: Width of the image, only provide if constant
  * @img_height: Height of the image, only provide if constant
  * @img_open: Open the device and do basic initialization
@@ -84,6 +87,7 @@ struct _FpImageDeviceClass
   FpDeviceClass parent_class;
 
   gint          bz3_threshold;
+  gint          max_minutiae;
   gint          img_width;
   gint          img_height;
 
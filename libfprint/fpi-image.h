@@ -67,9 +67,17 @@ struct _FpImage
   guint8    *binarized;
 
   GPtrArray *minutiae;
+  GVariant  *detection_timings;
   guint      ref_count;
 };
 
+void fpi_image_detect_minutiae_xyt (FpImage            *self,
+                                    GCancellable       *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer            user_data);
+
+gdouble fpi_image_get_foreground_ratio (FpImage *self);
+
 gint fpi_std_sq_dev (const guint8 *buf,
                      gint          size);
 gint fpi_mean_sq_diff_norm (const guint8 *buf1,
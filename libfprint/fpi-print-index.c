@@ -0,0 +1,512 @@
+/*
+ * Geometric hash index for NBIS prints
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define FP_COMPONENT "print-index"
+
+#include <math.h>
+
+#include "fpi-log.h"
+#include "fpi-print.h"
+#include "fpi-print-index.h"
+#include <nbis.h>
+
+/**
+ * SECTION: fpi-print-index
+ * @title: Print index
+ * @short_description: Candidate pre-selection for large galleries
+ *
+ * Running bozorth3 against every print of a large gallery is too slow for
+ * identification. The #FpiPrintIndex hashes every pair of nearby minutiae
+ * of the indexed prints by its rotation and translation invariant geometry
+ * (the distance between the two minutiae and the angle of each minutia
+ * relative to the line connecting them).
+ *
+ * A query looks up the pairs of the probe and votes for the prints sharing
+ * them. The vote of each pair is split between the closest bins of every
+ * dimension, so that pairs close to a bin border still find their
+ * counterpart. Only the prints with the most votes need to be passed on
+ * to the full matcher.
+ *
+ * The index is not thread-safe, callers need to serialise access to it.
+ */
+
+/* Only pairs that bozorth3 would consider as an edge are indexed */
+#define INDEX_MAX_DISTANCE DM
+#define INDEX_DISTANCE_BIN 8
+#define INDEX_DISTANCE_BINS (INDEX_MAX_DISTANCE / INDEX_DISTANCE_BIN + 1)
+#define INDEX_ANGLE_BINS 24
+
+#define INDEX_N_KEYS (INDEX_DISTANCE_BINS * INDEX_ANGLE_BINS * INDEX_ANGLE_BINS)
+
+/* Query votes are split between neighbouring bins in fixed point */
+#define INDEX_WEIGHT_ONE 16
+#define INDEX_VOTE_ONE (INDEX_WEIGHT_ONE * INDEX_WEIGHT_ONE * INDEX_WEIGHT_ONE)
+
+typedef struct
+{
+  FpPrint *print;
+  guint    slot;
+  GArray  *keys;
+} FpiPrintIndexEntry;
+
+/* The geometry of a minutiae pair, in units of bins */
+typedef struct
+{
+  gdouble dist;
+  gdouble angle_a;
+  gdouble angle_b;
+} PairGeometry;
+
+struct _FpiPrintIndex
+{
+  /* FpPrint -> FpiPrintIndexEntry */
+  GHashTable *entries;
+
+  /* Entries by slot, removed entries leave a NULL slot to be reused */
+  GPtrArray *slots;
+  GArray    *free_slots;
+
+  /* Posting list of slots for every key, allocated on first use */
+  GArray *postings[INDEX_N_KEYS];
+};
+
+static void
+fpi_print_index_entry_free (FpiPrintIndexEntry *entry)
+{
+  g_object_unref (entry->print);
+  g_array_unref (entry->keys);
+  g_free (entry);
+}
+
+static gdouble
+angle_position (gdouble angle)
+{
+  angle = fmod (angle, 360.0);
+  if (angle < 0)
+    angle += 360.0;
+
+  return angle * INDEX_ANGLE_BINS / 360.0;
+}
+
+static guint
+pair_key (gint dist_bin, gint a_bin, gint b_bin)
+{
+  guint key, key_swapped;
+
+  a_bin %= INDEX_ANGLE_BINS;
+  b_bin %= INDEX_ANGLE_BINS;
+
+  key = (dist_bin * INDEX_ANGLE_BINS + a_bin) * INDEX_ANGLE_BINS + b_bin;
+
+  /* Use the same key no matter in which order the two minutiae of the
+   * pair come. Swapping them turns the connecting line by 180°, which
+   * is exactly half of the angle bins. */
+  key_swapped = (dist_bin * INDEX_ANGLE_BINS +
+                 (b_bin + INDEX_ANGLE_BINS / 2) % INDEX_ANGLE_BINS) * INDEX_ANGLE_BINS +
+                (a_bin + INDEX_ANGLE_BINS / 2) % INDEX_ANGLE_BINS;
+
+  return MIN (key, key_swapped);
+}
+
+static GArray *
+compute_pairs (FpPrint *print)
+{
+  GPtrArray *prints = fpi_print_get_nbis_prints (print);
+  GArray *pairs;
+  gint p, i, j;
+
+  pairs = g_array_new (FALSE, FALSE, sizeof (PairGeometry));
+
+  for (p = 0; p < prints->len; p++)
+    {
+      struct xyt_struct *xyt = g_ptr_array_index (prints, p);
+
+      for (i = 0; i < xyt->nrows; i++)
+        {
+          for (j = i + 1; j < xyt->nrows; j++)
+            {
+              gint dx = xyt->xcol[j] - xyt->xcol[i];
+              gint dy = xyt->ycol[j] - xyt->ycol[i];
+              gint dist_sq = dx * dx + dy * dy;
+              PairGeometry pair;
+              gdouble phi;
+
+              if (dist_sq > INDEX_MAX_DISTANCE * INDEX_MAX_DISTANCE)
+                continue;
+
+              phi = atan2 (dy, dx) * 180.0 / G_PI;
+
+              pair.dist = sqrt (dist_sq) / INDEX_DISTANCE_BIN;
+              pair.angle_a = angle_position (xyt->thetacol[i] - phi);
+              pair.angle_b = angle_position (xyt->thetacol[j] - phi);
+
+              g_array_append_val (pairs, pair);
+            }
+        }
+    }
+
+  return pairs;
+}
+
+static GArray *
+compute_keys (FpPrint *print)
+{
+  g_autoptr(GArray) pairs = compute_pairs (print);
+  GArray *keys;
+  gint i;
+
+  keys = g_array_sized_new (FALSE, FALSE, sizeof (guint), pairs->len);
+
+  for (i = 0; i < pairs->len; i++)
+    {
+      PairGeometry *pair = &g_array_index (pairs, PairGeometry, i);
+      guint key;
+
+      key = pair_key ((gint) pair->dist, (gint) pair->angle_a, (gint) pair->angle_b);
+      g_array_append_val (keys, key);
+    }
+
+  return keys;
+}
+
+/* Splits a vote between the two bins whose centres are closest to
+ * @position, weighted by the distance to each of the centres. */
+static void
+interpolate_bins (gdouble  position,
+                  gint     n_bins,
+                  gboolean wrap,
+                  gint     bins[2],
+                  guint    weights[2])
+{
+  gdouble lower = floor (position - 0.5);
+
+  bins[0] = lower;
+  bins[1] = lower + 1;
+  weights[1] = lround ((position - 0.5 - lower) * INDEX_WEIGHT_ONE);
+  weights[0] = INDEX_WEIGHT_ONE - weights[1];
+
+  if (wrap)
+    {
+      bins[0] = (bins[0] + n_bins) % n_bins;
+      bins[1] = bins[1] % n_bins;
+    }
+  else if (bins[0] < 0)
+    {
+      bins[0] = 0;
+      weights[0] += weights[1];
+      weights[1] = 0;
+    }
+  else if (bins[1] >= n_bins)
+    {
+      bins[1] = n_bins - 1;
+      weights[1] += weights[0];
+      weights[0] = 0;
+    }
+}
+
+/**
+ * fpi_print_index_new:
+ *
+ * Creates a new, empty #FpiPrintIndex.
+ *
+ * Returns: (transfer full): A new #FpiPrintIndex
+ */
+FpiPrintIndex *
+fpi_print_index_new (void)
+{
+  FpiPrintIndex *index = g_new0 (FpiPrintIndex, 1);
+
+  index->entries = g_hash_table_new_full (NULL, NULL, NULL,
+                                          (GDestroyNotify) fpi_print_index_entry_free);
+  index->slots = g_ptr_array_new ();
+  index->free_slots = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  return index;
+}
+
+/**
+ * fpi_print_index_free:
+ * @index: A #FpiPrintIndex
+ *
+ * Frees @index and drops the references to the indexed prints.
+ */
+void
+fpi_print_index_free (FpiPrintIndex *index)
+{
+  gint i;
+
+  if (!index)
+    return;
+
+  for (i = 0; i < INDEX_N_KEYS; i++)
+    g_clear_pointer (&index->postings[i], g_array_unref);
+
+  g_hash_table_destroy (index->entries);
+  g_ptr_array_unref (index->slots);
+  g_array_unref (index->free_slots);
+  g_free (index);
+}
+
+/**
+ * fpi_print_index_add:
+ * @index: A #FpiPrintIndex
+ * @print: A #FpPrint of type #FP_PRINT_NBIS
+ *
+ * Adds @print to @index. The index keeps a reference to @print.
+ *
+ * Returns: %FALSE if @print cannot be indexed or is already part of @index
+ */
+gboolean
+fpi_print_index_add (FpiPrintIndex *index,
+                     FpPrint       *print)
+{
+  FpiPrintIndexEntry *entry;
+  gint i;
+
+  g_return_val_if_fail (index != NULL, FALSE);
+  g_return_val_if_fail (FP_IS_PRINT (print), FALSE);
+
+  if (!fpi_print_get_nbis_prints (print))
+    return FALSE;
+
+  if (g_hash_table_contains (index->entries, print))
+    return FALSE;
+
+  entry = g_new0 (FpiPrintIndexEntry, 1);
+  entry->print = g_object_ref (print);
+  entry->keys = compute_keys (print);
+
+  if (index->free_slots->len > 0)
+    {
+      entry->slot = g_array_index (index->free_slots, guint, index->free_slots->len - 1);
+      g_array_set_size (index->free_slots, index->free_slots->len - 1);
+      g_ptr_array_index (index->slots, entry->slot) = entry;
+    }
+  else
+    {
+      entry->slot = index->slots->len;
+      g_ptr_array_add (index->slots, entry);
+    }
+
+  for (i = 0; i < entry->keys->len; i++)
+    {
+      guint key = g_array_index (entry->keys, guint, i);
+
+      if (!index->postings[key])
+        index->postings[key] = g_array_new (FALSE, FALSE, sizeof (guint));
+      g_array_append_val (index->postings[key], entry->slot);
+    }
+
+  g_hash_table_insert (index->entries, print, entry);
+
+  fp_dbg ("Indexed print %p with %u minutiae pairs", print, entry->keys->len);
+
+  return TRUE;
+}
+
+/**
+ * fpi_print_index_remove:
+ * @index: A #FpiPrintIndex
+ * @print: A #FpPrint
+ *
+ * Removes @print from @index.
+ *
+ * Returns: %FALSE if @print was not part of @index
+ */
+gboolean
+fpi_print_index_remove (FpiPrintIndex *index,
+                        FpPrint       *print)
+{
+  FpiPrintIndexEntry *entry;
+  gint i, j;
+
+  g_return_val_if_fail (index != NULL, FALSE);
+
+  entry = g_hash_table_lookup (index->entries, print);
+  if (!entry)
+    return FALSE;
+
+  for (i = 0; i < entry->keys->len; i++)
+    {
+      GArray *posting = index->postings[g_array_index (entry->keys, guint, i)];
+
+      /* A key may be present several times, remove one occurrence for
+       * each time it was added. */
+      for (j = 0; j < posting->len; j++)
+        {
+          if (g_array_index (posting, guint, j) == entry->slot)
+            {
+              g_array_remove_index_fast (posting, j);
+              break;
+            }
+        }
+    }
+
+  g_ptr_array_index (index->slots, entry->slot) = NULL;
+  g_array_append_val (index->free_slots, entry->slot);
+
+  g_hash_table_remove (index->entries, print);
+
+  return TRUE;
+}
+
+/**
+ * fpi_print_index_contains:
+ * @index: A #FpiPrintIndex
+ * @print: A #FpPrint
+ *
+ * Returns: Whether @print is part of @index
+ */
+gboolean
+fpi_print_index_contains (FpiPrintIndex *index,
+                          FpPrint       *print)
+{
+  g_return_val_if_fail (index != NULL, FALSE);
+
+  return g_hash_table_contains (index->entries, print);
+}
+
+/**
+ * fpi_print_index_get_n_prints:
+ * @index: A #FpiPrintIndex
+ *
+ * Returns: The number of prints in @index
+ */
+guint
+fpi_print_index_get_n_prints (FpiPrintIndex *index)
+{
+  g_return_val_if_fail (index != NULL, 0);
+
+  return g_hash_table_size (index->entries);
+}
+
+typedef struct
+{
+  guint slot;
+  guint score;
+} Candidate;
+
+static gint
+candidate_compare (gconstpointer a, gconstpointer b)
+{
+  const Candidate *ca = a;
+  const Candidate *cb = b;
+
+  if (ca->score != cb->score)
+    return ca->score < cb->score ? 1 : -1;
+
+  return ca->slot < cb->slot ? -1 : ca->slot > cb->slot;
+}
+
+/**
+ * fpi_print_index_query:
+ * @index: A #FpiPrintIndex
+ * @probe: A newly scanned #FpPrint of type #FP_PRINT_NBIS
+ * @max_candidates: The maximum number of prints to return
+ *
+ * Searches @index for the prints that share the most minutiae pair
+ * geometries with @probe. Prints which share none are never returned.
+ *
+ * Returns: (transfer full) (element-type FpPrint): The best candidates,
+ *   most likely match first
+ */
+GPtrArray *
+fpi_print_index_query (FpiPrintIndex *index,
+                       FpPrint       *probe,
+                       guint          max_candidates)
+{
+  g_autoptr(GArray) probe_pairs = NULL;
+  g_autoptr(GArray) candidates = NULL;
+  g_autofree guint64 *votes = NULL;
+  GPtrArray *result;
+  gint i, j, d, a, b;
+
+  g_return_val_if_fail (index != NULL, NULL);
+  g_return_val_if_fail (FP_IS_PRINT (probe), NULL);
+
+  result = g_ptr_array_new_with_free_func (g_object_unref);
+  if (!fpi_print_get_nbis_prints (probe) || index->slots->len == 0)
+    return result;
+
+  probe_pairs = compute_pairs (probe);
+  votes = g_new0 (guint64, index->slots->len);
+
+  /* The minutiae of two scans never line up exactly, so each pair votes
+   * for the bins next to it as well. Otherwise pairs close to a border
+   * would randomly miss their counterpart in the other scan. */
+  for (i = 0; i < probe_pairs->len; i++)
+    {
+      PairGeometry *pair = &g_array_index (probe_pairs, PairGeometry, i);
+      gint dist_bins[2], a_bins[2], b_bins[2];
+      guint dist_weights[2], a_weights[2], b_weights[2];
+
+      interpolate_bins (pair->dist, INDEX_DISTANCE_BINS, FALSE, dist_bins, dist_weights);
+      interpolate_bins (pair->angle_a, INDEX_ANGLE_BINS, TRUE, a_bins, a_weights);
+      interpolate_bins (pair->angle_b, INDEX_ANGLE_BINS, TRUE, b_bins, b_weights);
+
+      for (d = 0; d < 2; d++)
+        for (a = 0; a < 2; a++)
+          for (b = 0; b < 2; b++)
+            {
+              guint weight = dist_weights[d] * a_weights[a] * b_weights[b];
+              GArray *posting;
+
+              if (weight == 0)
+                continue;
+
+              posting = index->postings[pair_key (dist_bins[d], a_bins[a], b_bins[b])];
+              if (!posting)
+                continue;
+
+              for (j = 0; j < posting->len; j++)
+                votes[g_array_index (posting, guint, j)] += weight;
+            }
+    }
+
+  /* Normalise by the number of pairs (Dice coefficient) so that prints
+   * with many minutiae are not favoured just because of their size. */
+  candidates = g_array_new (FALSE, FALSE, sizeof (Candidate));
+  for (i = 0; i < index->slots->len; i++)
+    {
+      FpiPrintIndexEntry *entry = g_ptr_array_index (index->slots, i);
+      Candidate candidate;
+
+      if (!entry || votes[i] == 0)
+        continue;
+
+      candidate.slot = i;
+      candidate.score = votes[i] * 20000 / ((guint64) INDEX_VOTE_ONE *
+                                            (entry->keys->len + probe_pairs->len));
+      g_array_append_val (candidates, candidate);
+    }
+
+  g_array_sort (candidates, candidate_compare);
+
+  for (i = 0; i < MIN (candidates->len, max_candidates); i++)
+    {
+      Candidate *candidate = &g_array_index (candidates, Candidate, i);
+      FpiPrintIndexEntry *entry = g_ptr_array_index (index->slots, candidate->slot);
+
+      g_ptr_array_add (result, g_object_ref (entry->print));
+    }
+
+  fp_dbg ("Index query returned %u of %u prints", result->len,
+          fpi_print_index_get_n_prints (index));
+
+  return result;
+}
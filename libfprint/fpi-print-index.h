@@ -0,0 +1,50 @@
+/*
+ * Geometric hash index for NBIS prints
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#pragma once
+
+#include "fp-print.h"
+
+G_BEGIN_DECLS
+
+/**
+ * FpiPrintIndex:
+ *
+ * An opaque index over the minutiae of #FP_PRINT_NBIS prints, used to
+ * quickly find the candidates worth running the full matcher on.
+ */
+typedef struct _FpiPrintIndex FpiPrintIndex;
+
+FpiPrintIndex *fpi_print_index_new (void);
+void           fpi_print_index_free (FpiPrintIndex *index);
+
+gboolean       fpi_print_index_add (FpiPrintIndex *index,
+                                    FpPrint       *print);
+gboolean       fpi_print_index_remove (FpiPrintIndex *index,
+                                       FpPrint       *print);
+gboolean       fpi_print_index_contains (FpiPrintIndex *index,
+                                         FpPrint       *print);
+guint          fpi_print_index_get_n_prints (FpiPrintIndex *index);
+
+GPtrArray     *fpi_print_index_query (FpiPrintIndex *index,
+                                      FpPrint       *probe,
+                                      guint          max_candidates);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FpiPrintIndex, fpi_print_index_free)
+
+G_END_DECLS
@@ -3,6 +3,7 @@
 #include "fpi-enums.h"
 #include "fp-device.h"
 #include "fp-print.h"
+#include "fp-print-gallery.h"
 
 G_BEGIN_DECLS
 
@@ -40,11 +41,46 @@ void     fpi_print_set_device_stored (FpPrint *print,
 
 gboolean fpi_print_add_from_image (FpPrint *print,
                                    FpImage *image,
+                                   gint     max_minutiae,
                                    GError **error);
 
+GPtrArray *fpi_print_get_nbis_prints (FpPrint *print);
+
+void     fpi_print_bz3_prepare (FpPrint *print);
+
 FpiMatchResult fpi_print_bz3_match (FpPrint * template,
                                     FpPrint * print,
                                     gint bz3_threshold,
                                     GError **error);
 
+void     fpi_print_bz3_identify (FpPrint            *print,
+                                 GPtrArray          *templates,
+                                 gint                bz3_threshold,
+                                 GCancellable       *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer            user_data);
+FpPrint *fpi_print_bz3_identify_finish (FpPrint      *print,
+                                        GAsyncResult *res,
+                                        GError      **error);
+
+void       fpi_print_bz3_identify_ranked (FpPrint            *print,
+                                          GPtrArray          *templates,
+                                          gint                bz3_threshold,
+                                          guint               max_results,
+                                          GCancellable       *cancellable,
+                                          GAsyncReadyCallback callback,
+                                          gpointer            user_data);
+GPtrArray *fpi_print_bz3_identify_ranked_finish (FpPrint      *print,
+                                                 GAsyncResult *res,
+                                                 GError      **error);
+
+FpMatchCandidate *fpi_match_candidate_new (FpPrint *print,
+                                           gint     score,
+                                           gboolean is_match);
+
+GPtrArray *fpi_print_gallery_get_candidates (FpPrintGallery *gallery,
+                                             GPtrArray      *prints,
+                                             FpPrint        *probe,
+                                             GPtrArray     **remaining);
+
 G_END_DECLS
@@ -22,3 +22,4 @@
 #include "fp-context.h"
 #include "fp-device.h"
 #include "fp-image.h"
+#include "fp-print-gallery.h"
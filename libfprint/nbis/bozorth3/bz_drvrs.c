@@ -64,6 +64,14 @@ of the software.
 #cat:                        same probe fingerprint is matches repeatedly
 #cat:                        to multiple gallery fingerprints as in
 #cat:                        identification mode
+#cat: bozorth_gallery_web_new - builds the pruned pairwise minutia
+#cat:                        comparison table of a gallery fingerprint
+#cat:                        so it can be reused for repeated matches
+#cat: bozorth_gallery_web_free - releases a table from
+#cat:                        bozorth_gallery_web_new
+#cat: bozorth_to_gallery_web - like bozorth_to_gallery, but with a
+#cat:                        prebuilt gallery table and an optional
+#cat:                        threshold to stop scoring early at
 #cat: bozorth_main -         supports the matching scenario where a
 #cat:                        single probe fingerprint is to be matched
 #cat:                        to a single gallery fingerprint as in
@@ -74,11 +82,12 @@ of the software.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <glib.h>
 #include <bozorth.h>
 
 /**************************************************************************/
 
-int bozorth_probe_init( struct xyt_struct * pstruct )
+int bozorth_probe_init( BzMatchContext * ctx, struct xyt_struct * pstruct )
 {
 int sim;	/* number of pointwise comparisons for Subject's record*/
 int msim;	/* Pruned length of Subject's comparison pointer list */
@@ -93,14 +102,15 @@ bz_comp(
 	pstruct->ycol,
 	pstruct->thetacol,
 	&sim,
-	scols,
-	scolpt );
+	ctx->scols,
+	ctx->scolpt,
+	ctx->simd );
 
 msim = sim;	/* Init search to end of Subject's pointwise comparison table (last edge in Web) */
 
 
 
-bz_find( &msim, scolpt );
+bz_find( &msim, ctx->scolpt );
 
 
 
@@ -116,7 +126,7 @@ return msim;
 
 /**************************************************************************/
 
-int bozorth_gallery_init( struct xyt_struct * gstruct )
+int bozorth_gallery_init( BzMatchContext * ctx, struct xyt_struct * gstruct )
 {
 int fim;	/* number of pointwise comparisons for On-File record*/
 int mfim;	/* Pruned length of On-File Record's pointer list */
@@ -130,14 +140,15 @@ bz_comp(
 	gstruct->ycol,
 	gstruct->thetacol,
 	&fim,
-	fcols,
-	fcolpt );
+	ctx->fcols,
+	ctx->fcolpt,
+	ctx->simd );
 
 mfim = fim;	/* Init search to end of On-File Record's pointwise comparison table (last edge in Web) */
 
 
 
-bz_find( &mfim, fcolpt );
+bz_find( &mfim, ctx->fcolpt );
 
 
 
@@ -154,6 +165,7 @@ return mfim;
 /**************************************************************************/
 
 int bozorth_to_gallery(
+		BzMatchContext * ctx,
 		int probe_len,
 		struct xyt_struct * pstruct,
 		struct xyt_struct * gstruct
@@ -162,9 +174,60 @@ int bozorth_to_gallery(
 int np;
 int gallery_len;
 
-gallery_len = bozorth_gallery_init( gstruct );
-np = bz_match( probe_len, gallery_len );
-return bz_match_score( np, pstruct, gstruct );
+gallery_len = bozorth_gallery_init( ctx, gstruct );
+np = bz_match( ctx, probe_len, ctx->fcolpt, gallery_len );
+return bz_match_score( ctx, np, pstruct, gstruct );
+}
+
+/**************************************************************************/
+
+struct bz_gallery_web * bozorth_gallery_web_new( BzMatchContext * ctx, struct xyt_struct * gstruct )
+{
+struct bz_gallery_web * web;
+int mfim;
+int i;
+
+
+/* Build the On-File Record's Web in the scratch tables of the context, */
+/* then keep only the pruned rows, copied in their sorted order. */
+mfim = bozorth_gallery_init( ctx, gstruct );
+
+web = (struct bz_gallery_web *) g_malloc( sizeof( struct bz_gallery_web )
+		+ mfim * sizeof( web->cols[0] )
+		+ mfim * sizeof( int * ) );
+web->len = mfim;
+web->colpt = (int **) &web->cols[mfim];
+
+for ( i = 0; i < mfim; i++ ) {
+	memcpy( web->cols[i], ctx->fcolpt[i], sizeof( web->cols[0] ) );
+	web->colpt[i] = web->cols[i];
+}
+
+return web;
+}
+
+/**************************************************************************/
+
+void bozorth_gallery_web_free( struct bz_gallery_web * web )
+{
+g_free( web );
+}
+
+/**************************************************************************/
+
+int bozorth_to_gallery_web(
+		BzMatchContext * ctx,
+		int probe_len,
+		struct xyt_struct * pstruct,
+		struct xyt_struct * gstruct,
+		struct bz_gallery_web * web,
+		int threshold
+		)
+{
+int np;
+
+np = bz_match( ctx, probe_len, web->colpt, web->len );
+return bz_match_score_threshold( ctx, np, pstruct, gstruct, threshold );
 }
 
 /**************************************************************************/
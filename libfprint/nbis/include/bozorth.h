@@ -223,46 +223,89 @@ extern FILE *stderr;
 /**************************************************************************/
 /* In: BZ_GBLS.C */
 /**************************************************************************/
-/* Global arrays supporting "core" bozorth algorithm */
-extern int colp[ COLP_SIZE_1 ][ COLP_SIZE_2 ];
-extern int scols[ SCOLS_SIZE_1 ][ COLS_SIZE_2 ];
-extern int fcols[ FCOLS_SIZE_1 ][ COLS_SIZE_2 ];
-extern int * scolpt[ SCOLPT_SIZE ];
-extern int * fcolpt[ FCOLPT_SIZE ];
-extern int sc[ SC_SIZE ];
-extern int yl[ YL_SIZE_1 ][ YL_SIZE_2 ];
-/* Global arrays supporting "core" bozorth algorithm continued: */
-/*    Globals used significantly by sift() */
-extern int rq[ RQ_SIZE ];
-extern int tq[ TQ_SIZE ];
-extern int zz[ ZZ_SIZE ];
-extern int rx[ RX_SIZE ];
-extern int mm[ MM_SIZE ];
-extern int nn[ NN_SIZE ];
-extern int qq[ QQ_SIZE ];
-extern int rk[ RK_SIZE ];
-extern int cp[ CP_SIZE ];
-extern int rp[ RP_SIZE ];
-extern int rf[RF_SIZE_1][RF_SIZE_2];
-extern int cf[CF_SIZE_1][CF_SIZE_2];
-extern int bz_y[20000];
+/* The arrays supporting the "core" bozorth algorithm used to be globals; */
+/* they are kept in a match context instead so that several matches can  */
+/* run concurrently, each with its own context.  A context is large      */
+/* (tens of megabytes of mostly untouched memory), so it should be       */
+/* allocated once per thread and reused for every match on that thread.  */
+typedef struct bz_match_context {
+	int simd;	/* Instruction set for bz_comp(), see bz_comp_simd_level() */
+	int colp[ COLP_SIZE_1 ][ COLP_SIZE_2 ];
+	int scols[ SCOLS_SIZE_1 ][ COLS_SIZE_2 ];
+	int fcols[ FCOLS_SIZE_1 ][ COLS_SIZE_2 ];
+	int * scolpt[ SCOLPT_SIZE ];
+	int * fcolpt[ FCOLPT_SIZE ];
+	int sc[ SC_SIZE ];
+	int yl[ YL_SIZE_1 ][ YL_SIZE_2 ];
+
+	/* Used significantly by sift() */
+	int rq[ RQ_SIZE ];
+	int tq[ TQ_SIZE ];
+	int zz[ ZZ_SIZE ];
+	int rx[ RX_SIZE ];
+	int mm[ MM_SIZE ];
+	int nn[ NN_SIZE ];
+	int qq[ QQ_SIZE ];
+	int rk[ RK_SIZE ];
+	int cp[ CP_SIZE ];
+	int rp[ RP_SIZE ];
+	int rf[ RF_SIZE_1 ][ RF_SIZE_2 ];
+	int cf[ CF_SIZE_1 ][ CF_SIZE_2 ];
+	int bz_y[ Y_SIZE ];
+
+	/* Formerly static within bz_match() */
+	int rot[ ROT_SIZE_1 ][ ROT_SIZE_2 ];
+	int * rtp[ ROT_SIZE_1 ];
+
+	/* Formerly static, shared by bz_match_score() & bz_final_loop() */
+	int ct[ CT_SIZE ];
+	int gct[ GCT_SIZE ];
+	int ctt[ CTT_SIZE ];
+	int ctp[ CTP_SIZE_1 ][ CTP_SIZE_2 ];
+	int yy[ YY_SIZE_1 ][ YY_SIZE_2 ][ YY_SIZE_3 ];
+	int sct[ SCT_SIZE_1 ][ SCT_SIZE_2 ];
+} BzMatchContext;
+
+/* The pruned and sorted pairwise comparison table ("Web") of an On-File */
+/* record only depends on that record, so it can be built once and then  */
+/* reused for every match against it.  It is allocated as a single block */
+/* and can be shared between threads, as matching only reads from it.    */
+struct bz_gallery_web {
+	int len;			/* Pruned length of the pointer list */
+	int ** colpt;			/* Sorted row pointers into cols[] */
+	int cols[][ COLS_SIZE_2 ];	/* Comparison rows, in sorted order */
+};
 
 /**************************************************************************/
 /**************************************************************************/
 /* ROUTINE PROTOTYPES */
 /**************************************************************************/
+/* In: BZ_GBLS.C */
+extern BzMatchContext *bz_match_context_new(void);
+extern void bz_match_context_free(BzMatchContext *);
 /* In: BZ_DRVRS.C */
-extern int bozorth_probe_init( struct xyt_struct *);
-extern int bozorth_gallery_init( struct xyt_struct *);
-extern int bozorth_to_gallery(int, struct xyt_struct *, struct xyt_struct *);
+extern int bozorth_probe_init(BzMatchContext *, struct xyt_struct *);
+extern int bozorth_gallery_init(BzMatchContext *, struct xyt_struct *);
+extern int bozorth_to_gallery(BzMatchContext *, int, struct xyt_struct *,
+                    struct xyt_struct *);
+extern struct bz_gallery_web *bozorth_gallery_web_new(BzMatchContext *,
+                    struct xyt_struct *);
+extern void bozorth_gallery_web_free(struct bz_gallery_web *);
+extern int bozorth_to_gallery_web(BzMatchContext *, int, struct xyt_struct *,
+                    struct xyt_struct *, struct bz_gallery_web *, int);
 extern int bozorth_main(struct xyt_struct *, struct xyt_struct *);
 /* In: BOZORTH3.C */
+extern int bz_comp_simd_level(void);
 extern void bz_comp(int, int [], int [], int [], int *, int [][COLS_SIZE_2],
-                    int *[]);
+                    int *[], int);
 extern void bz_find(int *, int *[]);
-extern int bz_match(int, int);
-extern int bz_match_score(int, struct xyt_struct *, struct xyt_struct *);
-extern void bz_sift(int *, int, int *, int, int, int, int *, int *);
+extern int bz_match(BzMatchContext *, int, int **, int);
+extern int bz_match_score(BzMatchContext *, int, struct xyt_struct *,
+                    struct xyt_struct *);
+extern int bz_match_score_threshold(BzMatchContext *, int, struct xyt_struct *,
+                    struct xyt_struct *, int);
+extern void bz_sift(BzMatchContext *, int *, int, int *, int, int, int, int *,
+                    int *);
 /* In: BZ_ALLOC.C */
 extern char *malloc_or_exit(int, const char *);
 extern char *malloc_or_return_error(int, const char *);
@@ -76,6 +76,11 @@ of the software.
 
 
 
+#define ROT_SIZE_1 20000
+#define ROT_SIZE_2 5
+
+
+
 #define RR_SIZE     100
 #define AVN_SIZE      5
 #define AVV_SIZE_1 2000
@@ -120,6 +120,9 @@ typedef struct dir2rad{
 typedef struct dftwave{
    double *cos;
    double *sin;
+   /* The same wave form in fixed point, scaled by DFT_FIXED_ONE. */
+   int *fixed_cos;
+   int *fixed_sin;
 } DFTWAVE;
 
 /* DFT wave forms structure containing all wave forms  */
@@ -128,6 +131,10 @@ typedef struct dftwaves{
    int nwaves;
    int wavelen;
    DFTWAVE **waves;
+   /* The cos and sin points of all waves, interleaved per row, */
+   /* and the instruction set used to apply them (see dft.c).   */
+   double *wavetab;
+   int simd;
 }DFTWAVES;
 
 /* Rotated pixel offsets for a grid of specified dimensions */
@@ -145,6 +152,54 @@ typedef struct rotgrids{
    int **grids;
 } ROTGRIDS;
 
+/* Lookup tables needed to detect minutiae, which only depend on the */
+/* image width and the LFS parameters.  They are shared between      */
+/* calls and threads, so they must only be read once created.        */
+typedef struct lfssetup{
+   int ref_count;
+   int iw;
+   int maxpad;
+   int num_directions;
+   double start_dir_angle;
+   int num_dft_waves;
+   int windowsize;
+   int dirbin_grid_w;
+   int dirbin_grid_h;
+   DIR2RAD *dir2rad;
+   DFTWAVES *dftwaves;
+   ROTGRIDS *dftgrids;
+   ROTGRIDS *dirbingrids;
+} LFSSETUP;
+
+/* Maximum number of setups kept around for reuse. */
+#define MAX_LFS_SETUPS 4
+
+/* Memory arena for the temporary allocations of one minutiae detection */
+typedef struct lfsarena LFSARENA;
+
+/* Stages of a minutiae detection that are timed. */
+#define LFS_STAGE_MAPS                    0
+#define LFS_STAGE_BINARIZE                1
+#define LFS_STAGE_DETECT                  2
+#define LFS_STAGE_SORT                    3
+#define LFS_STAGE_ISLANDS_AND_LAKES       4
+#define LFS_STAGE_HOLES                   5
+#define LFS_STAGE_POINTING_INVBLOCK       6
+#define LFS_STAGE_NEAR_INVBLOCK           7
+#define LFS_STAGE_SIDE_MINUTIAE           8
+#define LFS_STAGE_HOOKS                   9
+#define LFS_STAGE_OVERLAPS               10
+#define LFS_STAGE_MALFORMATIONS          11
+#define LFS_STAGE_PORES                  12
+#define LFS_STAGE_RIDGE_COUNT            13
+#define LFS_STAGE_QUALITY                14
+#define NUM_LFS_STAGES                   15
+
+/* Time (in seconds) spent in each stage of a minutiae detection. */
+typedef struct lfstimings{
+   double stages[NUM_LFS_STAGES];
+} LFSTIMINGS;
+
 /*************************************************************************/
 /* 10, 2X3 pixel pair feature patterns used to define ridge endings      */
 /* and bifurcations.                                                     */
@@ -158,6 +213,24 @@ typedef struct rotgrids{
 typedef struct fp_minutia MINUTIA;
 typedef struct fp_minutiae MINUTIAE;
 
+/* Uniform grid over the minutiae of a list, used to look up the ones */
+/* close to a point without going through the whole list.  The nodes  */
+/* are numbered in the order the minutiae were added, and each cell   */
+/* links its nodes from the most recent one on.                       */
+typedef struct minutiagridnode{
+   MINUTIA *minutia;
+   int next;
+} MINUTIAGRIDNODE;
+
+typedef struct minutiagrid{
+   int cell_size;
+   int gw, gh;
+   int *cells;
+   MINUTIAGRIDNODE *nodes;
+   int num_nodes, alloc_nodes;
+   int *found;
+} MINUTIAGRID;
+
 typedef struct feature_pattern{
    int type;
    int appearing;
@@ -264,6 +337,12 @@ typedef struct g_lfsparms{
    /* Ridge Counting Controls */
    int    max_nbrs;
    int    max_ridge_steps;
+
+   /* Arithmetic Controls */
+   int    fixed_point;
+
+   /* Extraction Profile */
+   int    profile;
 } LFSPARMS;
 
 /*************************************************************************/
@@ -394,6 +473,12 @@ typedef struct g_lfsparms{
 /* This specifies the number of DFT wave forms to be applied */
 #define NUM_DFT_WAVES            4
 
+/* Scale of the fixed point DFT wave forms.  The sums of the products */
+/* of 8-bit pixel row sums with these stay exact in 64 bits for any   */
+/* reasonable window size.                                            */
+#define DFT_FIXED_BITS          14
+#define DFT_FIXED_ONE           (1 << DFT_FIXED_BITS)
+
 /* Minimum total DFT power for any given block  */
 /* which is used to compute an average power.   */
 /* By setting a non-zero minimum total,possible */
@@ -619,6 +704,15 @@ typedef struct g_lfsparms{
 /* Maximum number of contour steps taken to validate a ridge crossing. */
 #define MAX_RIDGE_STEPS         10
 
+/***** EXTRACTION PROFILES *****/
+
+/* Compute all the minutiae attributes. */
+#define LFS_PROFILE_FULL         0
+/* Only compute what XYT templates, as used by bozorth3, hold: the   */
+/* position, direction and reliability.  Neighbors and ridge counts */
+/* are not determined.                                               */
+#define LFS_PROFILE_XYT          1
+
 /*************************************************************************/
 /*         QUALITY/RELIABILITY DEFINITIONS                               */
 /*************************************************************************/
@@ -789,6 +883,12 @@ extern int dft_dir_powers(double **, unsigned char *, const int,
 extern void sum_rot_block_rows(int *, const unsigned char *, const int *,
                      const int);
 extern void dft_power(double *, const int *, const DFTWAVE *, const int);
+extern int dft_simd_level(void);
+extern int dft_dir_powers_fixed(double **, unsigned char *, const int,
+                     const int, const int, const DFTWAVES *,
+                     const ROTGRIDS *);
+extern void dft_power_fixed(double *, const int *, const DFTWAVE *,
+                     const int);
 extern int dft_power_stats(int *, double *, int *, double *, double **,
                      const int, const int, const int);
 extern void get_max_norm(double *, int *, double *, const double *, const int);
@@ -831,6 +931,8 @@ extern int init_rotgrids(ROTGRIDS **, const int, const int, const int,
                      const double, const int, const int, const int, const int);
 extern int alloc_dir_powers(double ***, const int, const int);
 extern int alloc_power_stats(int **, double **, int **, double **, const int);
+extern int get_lfs_setup(LFSSETUP **, const int, const int, const LFSPARMS *);
+extern void release_lfs_setup(LFSSETUP *);
 
 /* isempty.c */
 extern int is_image_empty(int *, const int, const int);
@@ -970,7 +1072,8 @@ extern int detect_minutiae_V2(MINUTIAE *,
                      const LFSPARMS *);
 extern int update_minutiae(MINUTIAE *, MINUTIA *, unsigned char *,
                      const int, const int, const LFSPARMS *);
-extern int update_minutiae_V2(MINUTIAE *, MINUTIA *, const int, const int,
+extern int update_minutiae_V2(MINUTIAE *, MINUTIAGRID *, MINUTIA *,
+                     const int, const int,
                      unsigned char *, const int, const int,
                      const LFSPARMS *);
 extern int sort_minutiae(MINUTIAE *, const int, const int);
@@ -986,6 +1089,13 @@ extern int create_minutia(MINUTIA **, const int, const int,
 extern void free_minutiae(MINUTIAE *);
 extern void free_minutia(MINUTIA *);
 extern int remove_minutia(const int, MINUTIAE *);
+extern int alloc_minutia_grid(MINUTIAGRID **, const int, const int,
+                     const int);
+extern void free_minutia_grid(MINUTIAGRID *);
+extern void add_grid_minutia(MINUTIAGRID *, MINUTIA *);
+extern void remove_grid_minutia(MINUTIAGRID *, const int);
+extern int find_grid_minutiae(MINUTIAGRID *, const int, const int,
+                     const int);
 extern int join_minutia(const MINUTIA *, const MINUTIA *, unsigned char *,
                      const int, const int, const int, const int);
 extern int minutia_type(const int);
@@ -999,7 +1109,7 @@ extern int scan4minutiae_horizontally(MINUTIAE *, unsigned char *,
                      const int, const int, const int, const int,
                      const int, const int, const int, const int,
                      const LFSPARMS *);
-extern int scan4minutiae_horizontally_V2(MINUTIAE *,
+extern int scan4minutiae_horizontally_V2(MINUTIAE *, MINUTIAGRID *,
                      unsigned char *, const int, const int,
                      int *, int *, int *,
                      const LFSPARMS *);
@@ -1012,7 +1122,7 @@ extern int rescan4minutiae_horizontally(MINUTIAE *, unsigned char *bdata,
                      const int, const int, const int, const int,
                      const int, const int, const int, const int,
                      const LFSPARMS *);
-extern int scan4minutiae_vertically_V2(MINUTIAE *,
+extern int scan4minutiae_vertically_V2(MINUTIAE *, MINUTIAGRID *,
                      unsigned char *, const int, const int,
                      int *, int *, int *, const LFSPARMS *);
 extern int rescan4minutiae_vertically(MINUTIAE *, unsigned char *,
@@ -1042,7 +1152,7 @@ extern int process_horizontal_scan_minutia(MINUTIAE *, const int, const int,
                      const int, const int,
                      unsigned char *, const int, const int,
                      const int, const int, const LFSPARMS *);
-extern int process_horizontal_scan_minutia_V2(MINUTIAE *,
+extern int process_horizontal_scan_minutia_V2(MINUTIAE *, MINUTIAGRID *,
                      const int, const int, const int, const int,
                      unsigned char *, const int, const int,
                      int *, int *, int *, const LFSPARMS *);
@@ -1050,11 +1160,12 @@ extern int process_vertical_scan_minutia(MINUTIAE *, const int, const int,
                      const int, const int,
                      unsigned char *, const int, const int,
                      const int, const int, const LFSPARMS *);
-extern int process_vertical_scan_minutia_V2(MINUTIAE *, const int, const int,
-                     const int, const int,
+extern int process_vertical_scan_minutia_V2(MINUTIAE *, MINUTIAGRID *,
+                     const int, const int, const int, const int,
                      unsigned char *, const int, const int,
                      int *, int *, int *, const LFSPARMS *);
-extern int update_minutiae_V2(MINUTIAE *, MINUTIA *, const int, const int,
+extern int update_minutiae_V2(MINUTIAE *, MINUTIAGRID *, MINUTIA *,
+                     const int, const int,
                      unsigned char *, const int, const int,
                      const LFSPARMS *);
 extern int adjust_high_curvature_minutia(int *, int *, int *, int *, int *,
@@ -1200,6 +1311,16 @@ extern double angle2line(const int, const int, const int, const int);
 extern int line2direction(const int, const int, const int, const int,
                      const int);
 extern int closest_dir_dist(const int, const int, const int);
+extern void run_lfs_workers(void (*)(void *), void *, const int);
+extern LFSARENA *new_lfs_arena(void);
+extern void free_lfs_arena(LFSARENA *);
+extern LFSARENA *set_lfs_arena(LFSARENA *);
+extern void *lfs_malloc(const size_t);
+extern void *lfs_realloc(void *, const size_t);
+extern void lfs_free(void *);
+extern LFSTIMINGS *set_lfs_timings(LFSTIMINGS *);
+extern gint64 lfs_stage_start(void);
+extern void lfs_stage_done(const int, const gint64);
 
 /* xytreps.c */
 extern void lfs2nist_minutia_XYT(int *, int *, int *,
@@ -1217,5 +1338,6 @@ extern int g_nbr8_dx[];
 extern int g_nbr8_dy[];
 extern int g_chaincodes_nbr8[];
 extern FEATURE_PATTERN g_feature_patterns[];
+extern char *g_lfs_stage_names[];
 
 #endif
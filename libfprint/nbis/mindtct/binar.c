@@ -201,33 +201,44 @@ int binarize_V2(unsigned char **odata, int *ow, int *oh,
       Zero     - successful completion
       Negative - system error
 **************************************************************************/
-int binarize_image_V2(unsigned char **odata, int *ow, int *oh,
-                   unsigned char *pdata, const int pw, const int ph,
-                   const int *direction_map, const int mw, const int mh,
-                   const int blocksize, const ROTGRIDS *dirbingrids)
+/* Every binary pixel only depends on the padded input image and the  */
+/* Direction Map, so stripes of rows are binarized by a pool of worker */
+/* threads.  Small images are not worth splitting up.                 */
+#define BINARIZE_STRIPE_ROWS 16
+
+typedef struct binarizejob{
+   unsigned char *bdata;
+   int bw, bh;
+   unsigned char *pdata;
+   int pw;
+   const int *direction_map;
+   int mw;
+   int blocksize;
+   const ROTGRIDS *dirbingrids;
+
+   /* Accessed atomically by the workers */
+   int next_stripe;
+} BINARIZEJOB;
+
+static void binarize_rows_V2(BINARIZEJOB *job, const int fy, const int ty)
 {
-   int ix, iy, bw, bh, bx, by, mapval;
-   unsigned char *bdata, *bptr;
+   int ix, iy, bx, by, mapval;
+   unsigned char *bptr;
    unsigned char *pptr, *spptr;
 
-   /* Compute dimensions of "unpadded" binary image results. */
-   bw = pw - (dirbingrids->pad<<1);
-   bh = ph - (dirbingrids->pad<<1);
-
-   bdata = (unsigned char *)g_malloc(bw * bh * sizeof(unsigned char));
-
-   bptr = bdata;
-   spptr = pdata + (dirbingrids->pad * pw) + dirbingrids->pad;
-   for(iy = 0; iy < bh; iy++){
+   bptr = job->bdata + (fy * job->bw);
+   spptr = job->pdata + ((job->dirbingrids->pad + fy) * job->pw) +
+           job->dirbingrids->pad;
+   for(iy = fy; iy < ty; iy++){
       /* Set pixel pointer to start of next row in grid. */
       pptr = spptr;
-      for(ix = 0; ix < bw; ix++){
+      for(ix = 0; ix < job->bw; ix++){
 
          /* Compute which block the current pixel is in. */
-         bx = (int)(ix/blocksize);
-         by = (int)(iy/blocksize);
+         bx = (int)(ix/job->blocksize);
+         by = (int)(iy/job->blocksize);
          /* Get corresponding value in Direction Map. */
-         mapval = *(direction_map + (by*mw) + bx);
+         mapval = *(job->direction_map + (by*job->mw) + bx);
          /* If current block has has INVALID direction ... */
          if(mapval == INVALID_DIR)
             /* Set binary pixel to white (255). */
@@ -235,19 +246,58 @@ int binarize_image_V2(unsigned char **odata, int *ow, int *oh,
          /* Otherwise, if block has a valid direction ... */
          else /*if(mapval >= 0)*/
             /* Use directional binarization based on block's direction. */
-            *bptr = dirbinarize(pptr, mapval, dirbingrids);
+            *bptr = dirbinarize(pptr, mapval, job->dirbingrids);
 
          /* Bump input and output pixel pointers. */
          pptr++;
          bptr++;
       }
       /* Bump pointer to the next row in padded input image. */
-      spptr += pw;
+      spptr += job->pw;
    }
+}
 
-   *odata = bdata;
-   *ow = bw;
-   *oh = bh;
+static void binarize_image_worker(void *data)
+{
+   BINARIZEJOB *job = (BINARIZEJOB *)data;
+   int fy;
+
+   /* Claim stripes of rows until the image is done. */
+   while((fy = g_atomic_int_add(&job->next_stripe, 1) *
+               BINARIZE_STRIPE_ROWS) < job->bh)
+      binarize_rows_V2(job, fy, min(fy + BINARIZE_STRIPE_ROWS, job->bh));
+}
+
+int binarize_image_V2(unsigned char **odata, int *ow, int *oh,
+                   unsigned char *pdata, const int pw, const int ph,
+                   const int *direction_map, const int mw, const int mh,
+                   const int blocksize, const ROTGRIDS *dirbingrids)
+{
+   BINARIZEJOB job;
+   int nstripes, nworkers;
+
+   /* Compute dimensions of "unpadded" binary image results. */
+   job.bw = pw - (dirbingrids->pad<<1);
+   job.bh = ph - (dirbingrids->pad<<1);
+
+   job.bdata = (unsigned char *)g_malloc(job.bw * job.bh *
+                                         sizeof(unsigned char));
+   job.pdata = pdata;
+   job.pw = pw;
+   job.direction_map = direction_map;
+   job.mw = mw;
+   job.blocksize = blocksize;
+   job.dirbingrids = dirbingrids;
+   job.next_stripe = 0;
+
+   nstripes = (job.bh + BINARIZE_STRIPE_ROWS - 1) / BINARIZE_STRIPE_ROWS;
+   nworkers = min(g_get_num_processors(), nstripes);
+
+   run_lfs_workers(binarize_image_worker, &job, nworkers);
+
+   *odata = job.bdata;
+   *ow = job.bw;
+   *oh = job.bh;
    return(0);
 }
 
@@ -275,16 +325,12 @@ int dirbinarize(const unsigned char *pptr, const int idir,
    int gx, gy, gi, cy;
    int rsum, gsum, csum = 0;
    int *grid;
-   double dcy;
 
    /* Assign nickname pointer. */
    grid = dirbingrids->grids[idir];
-   /* Calculate center (0-oriented) row in grid. */
-   dcy = (dirbingrids->grid_h-1)/(double)2.0;
-   /* Need to truncate precision so that answers are consistent */
-   /* on different computer architectures when rounding doubles. */
-   dcy = trunc_dbl_precision(dcy, TRUNC_SCALE);
-   cy = sround(dcy);
+   /* Calculate center (0-oriented) row in grid.  This is the same as */
+   /* rounding (grid_h-1)/2.0, but avoids doing so for every pixel.   */
+   cy = dirbingrids->grid_h / 2;
    /* Initialize grid's pixel offset index to zero. */
    gi = 0;
    /* Initialize grid's pixel accumulator to zero */
@@ -141,6 +141,7 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
 {
    unsigned char *pdata, *bdata;
    int pw, ph, bw, bh;
+   LFSSETUP *setup;
    DIR2RAD *dir2rad;
    DFTWAVES *dftwaves;
    ROTGRIDS *dftgrids;
@@ -149,6 +150,7 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
    int mw, mh;
    int ret, maxpad;
    MINUTIAE *minutiae;
+   gint64 start;
 
    set_timer(total_timer);
 
@@ -166,42 +168,25 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
    maxpad = get_max_padding_V2(lfsparms->windowsize, lfsparms->windowoffset,
                           lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h);
 
-   /* Initialize lookup table for converting integer directions */
-   /* to angles in radians.                                     */
-   if((ret = init_dir2rad(&dir2rad, lfsparms->num_directions))){
-      /* Free memory allocated to this point. */
-      return(ret);
-   }
-
-   /* Initialize wave form lookup tables for DFT analyses. */
-   /* used for direction binarization.                             */
-   if((ret = init_dftwaves(&dftwaves, g_dft_coefs, lfsparms->num_dft_waves,
-                        lfsparms->windowsize))){
-      /* Free memory allocated to this point. */
-      free_dir2rad(dir2rad);
-      return(ret);
-   }
-
-   /* Initialize lookup table for pixel offsets to rotated grids */
-   /* used for DFT analyses.                                     */
-   if((ret = init_rotgrids(&dftgrids, iw, ih, maxpad,
-                        lfsparms->start_dir_angle, lfsparms->num_directions,
-                        lfsparms->windowsize, lfsparms->windowsize,
-                        RELATIVE2ORIGIN))){
-      /* Free memory allocated to this point. */
-      free_dir2rad(dir2rad);
-      free_dftwaves(dftwaves);
+   /* Get the lookup tables for converting integer directions to  */
+   /* angles in radians, the wave forms for DFT analyses and the   */
+   /* pixel offsets to rotated grids used for DFT analyses and for */
+   /* directional binarization.  These only depend on the image    */
+   /* width and parameters, so they are shared between calls.      */
+   if((ret = get_lfs_setup(&setup, iw, maxpad, lfsparms))){
       return(ret);
    }
+   dir2rad = setup->dir2rad;
+   dftwaves = setup->dftwaves;
+   dftgrids = setup->dftgrids;
+   dirbingrids = setup->dirbingrids;
 
    /* Pad input image based on max padding. */
    if(maxpad > 0){   /* May not need to pad at all */
       if((ret = pad_uchar_image(&pdata, &pw, &ph, idata, iw, ih,
                              maxpad, lfsparms->pad_value))){
          /* Free memory allocated to this point. */
-         free_dir2rad(dir2rad);
-         free_dftwaves(dftwaves);
-         free_rotgrids(dftgrids);
+         release_lfs_setup(setup);
          return(ret);
       }
    }
@@ -227,22 +212,19 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
    /*      MAPS      */
    /******************/
    set_timer(imap_timer);
+   start = lfs_stage_start();
 
    /* Generate block maps from the input image. */
    if((ret = gen_image_maps(&direction_map, &low_contrast_map,
                     &low_flow_map, &high_curve_map, &mw, &mh,
                     pdata, pw, ph, dir2rad, dftwaves, dftgrids, lfsparms))){
       /* Free memory allocated to this point. */
-      free_dir2rad(dir2rad);
-      free_dftwaves(dftwaves);
-      free_rotgrids(dftgrids);
+      release_lfs_setup(setup);
       g_free(pdata);
       return(ret);
    }
-   /* Deallocate working memories. */
-   free_dir2rad(dir2rad);
-   free_dftwaves(dftwaves);
-   free_rotgrids(dftgrids);
+
+   lfs_stage_done(LFS_STAGE_MAPS, start);
 
    print2log("\nMAPS DONE\n");
 
@@ -252,21 +234,7 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
    /* BINARIZARION   */
    /******************/
    set_timer(bin_timer);
-
-   /* Initialize lookup table for pixel offsets to rotated grids */
-   /* used for directional binarization.                         */
-   if((ret = init_rotgrids(&dirbingrids, iw, ih, maxpad,
-                        lfsparms->start_dir_angle, lfsparms->num_directions,
-                        lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h,
-                        RELATIVE2CENTER))){
-      /* Free memory allocated to this point. */
-      g_free(pdata);
-      g_free(direction_map);
-      g_free(low_contrast_map);
-      g_free(low_flow_map);
-      g_free(high_curve_map);
-      return(ret);
-   }
+   start = lfs_stage_start();
 
    /* Binarize input image based on NMAP information. */
    if((ret = binarize_V2(&bdata, &bw, &bh,
@@ -278,12 +246,12 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
       g_free(low_contrast_map);
       g_free(low_flow_map);
       g_free(high_curve_map);
-      free_rotgrids(dirbingrids);
+      release_lfs_setup(setup);
       return(ret);
    }
 
-   /* Deallocate working memory. */
-   free_rotgrids(dirbingrids);
+   /* Release the lookup tables. */
+   release_lfs_setup(setup);
 
    /* Check dimension of binary image.  If they are different from */
    /* the input image, then ERROR.                                 */
@@ -301,6 +269,8 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
       return(-581);
    }
 
+   lfs_stage_done(LFS_STAGE_BINARIZE, start);
+
    print2log("\nBINARIZATION DONE\n");
 
    time_accum(bin_timer, bin_time);
@@ -309,6 +279,7 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
    /*   DETECTION    */
    /******************/
    set_timer(minutia_timer);
+   start = lfs_stage_start();
 
    /* Convert 8-bit grayscale binary image [0,255] to */
    /* 8-bit binary image [0,1].                       */
@@ -333,6 +304,8 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
       return(ret);
    }
 
+   lfs_stage_done(LFS_STAGE_DETECT, start);
+
    time_accum(minutia_timer, minutia_time);
 
    set_timer(rm_minutia_timer);
@@ -359,6 +332,7 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
    /*  RIDGE COUNTS  */
    /******************/
    set_timer(ridge_count_timer);
+   start = lfs_stage_start();
 
    if((ret = count_minutiae_ridges(minutiae, bdata, iw, ih, lfsparms))){
       /* Free memory allocated to this point. */
@@ -371,6 +345,7 @@ int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
       return(ret);
    }
 
+   lfs_stage_done(LFS_STAGE_RIDGE_COUNT, start);
 
    print2log("\nNEIGHBOR RIDGE COUNT DONE\n");
 
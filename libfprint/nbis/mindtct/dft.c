@@ -59,6 +59,9 @@ of the software.
                         dft_dir_powers()
                         sum_rot_block_rows()
                         dft_power()
+                        dft_simd_level()
+                        dft_dir_powers_fixed()
+                        dft_power_fixed()
                         dft_power_stats()
                         get_max_norm()
                         sort_dft_waves()
@@ -67,6 +70,17 @@ of the software.
 #include <stdio.h>
 #include <lfs.h>
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define DFT_X86_SIMD
+#include <immintrin.h>
+
+static void sum_rot_block_rows_avx2(int *, const unsigned char *,
+                                    const int *, const int);
+#endif
+
+static void dft_dir_powers_waves(double **, const int, const int *,
+                                 const DFTWAVES *);
+
 /*************************************************************************
 **************************************************************************
 #cat: dft_dir_powers - Conducts the DFT analysis on a block of image data.
@@ -103,9 +117,10 @@ int dft_dir_powers(double **powers, unsigned char *pdata,
                const int blkoffset, const int pw, const int ph,
                const DFTWAVES *dftwaves, const ROTGRIDS *dftgrids)
 {
-   int w, dir;
+   int dir;
    int *rowsums;
    unsigned char *blkptr;
+   int gather;
 
    /* Allocate line sum vector, and initialize to zeros */
    /* This routine requires square block (grid), so ERROR otherwise. */
@@ -116,18 +131,27 @@ int dft_dir_powers(double **powers, unsigned char *pdata,
    rowsums = (int *)g_malloc(dftgrids->grid_w * sizeof(int));
    memset(rowsums, 0, dftgrids->grid_w * sizeof(int));
 
+   /* The gathered row sums load 4 bytes per pixel, so they may only */
+   /* be used if the rotated grid stays clear of the image's end.    */
+   gather = (dftwaves->simd > 1) &&
+            (blkoffset + ((dftgrids->grid_h + dftgrids->pad) * pw) +
+             dftgrids->grid_w + dftgrids->pad + 3 <= pw * ph);
+
    /* Foreach direction ... */
    for(dir = 0; dir < dftgrids->ngrids; dir++){
       /* Compute vector of line sums from rotated grid */
       blkptr = pdata + blkoffset;
-      sum_rot_block_rows(rowsums, blkptr,
-                         dftgrids->grids[dir], dftgrids->grid_w);
+#ifdef DFT_X86_SIMD
+      if(gather)
+         sum_rot_block_rows_avx2(rowsums, blkptr,
+                                 dftgrids->grids[dir], dftgrids->grid_w);
+      else
+#endif
+         sum_rot_block_rows(rowsums, blkptr,
+                            dftgrids->grids[dir], dftgrids->grid_w);
 
       /* Foreach DFT wave ... */
-      for(w = 0; w < dftwaves->nwaves; w++){
-         dft_power(&(powers[w][dir]), rowsums,
-                   dftwaves->waves[w], dftwaves->wavelen);
-      }
+      dft_dir_powers_waves(powers, dir, rowsums, dftwaves);
    }
 
    /* Deallocate working memory. */
@@ -175,6 +199,47 @@ void sum_rot_block_rows(int *rowsums, const unsigned char *blkptr,
    }
 }
 
+#ifdef DFT_X86_SIMD
+/*************************************************************************
+**************************************************************************
+#cat: sum_rot_block_rows_avx2 - Same as sum_rot_block_rows(), but gathers
+#cat:               eight pixels of a rotated row at once.  Each gather
+#cat:               loads 4 bytes starting at the pixel, so the caller has
+#cat:               to make sure that 3 more bytes are readable after each
+#cat:               pixel of the grid.
+**************************************************************************/
+__attribute__((target("avx2")))
+static void sum_rot_block_rows_avx2(int *rowsums, const unsigned char *blkptr,
+                                    const int *grid_offsets, const int blocksize)
+{
+   __m256i lo = _mm256_set1_epi32(0xff);
+   __m128i sum;
+   int ix, iy, gi;
+
+   gi = 0;
+   for(iy = 0; iy < blocksize; iy++){
+      __m256i acc = _mm256_setzero_si256();
+
+      for(ix = 0; ix + 8 <= blocksize; ix += 8, gi += 8){
+         __m256i offsets = _mm256_loadu_si256((const __m256i *)(grid_offsets + gi));
+         __m256i pixels = _mm256_i32gather_epi32((const int *)blkptr, offsets, 1);
+
+         acc = _mm256_add_epi32(acc, _mm256_and_si256(pixels, lo));
+      }
+
+      /* Add up the lanes and the pixels left over */
+      sum = _mm_add_epi32(_mm256_castsi256_si128(acc),
+                          _mm256_extracti128_si256(acc, 1));
+      sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+      sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+      rowsums[iy] = _mm_cvtsi128_si32(sum);
+
+      for(; ix < blocksize; ix++, gi++)
+         rowsums[iy] += *(blkptr + grid_offsets[gi]);
+   }
+}
+#endif
+
 /*************************************************************************
 **************************************************************************
 #cat: dft_power - Computes the DFT power by applying a specific wave form
@@ -214,6 +279,227 @@ void dft_power(double *power, const int *rowsums,
    *power = (cospart * cospart) + (sinpart * sinpart);
 }
 
+/*************************************************************************
+**************************************************************************
+#cat: dft_simd_level - Determines the instruction set that dft_dir_powers()
+#cat:             can use on this processor.  This is done once when the
+#cat:             DFT wave forms are set up, and not for every image block.
+
+   Return Code:
+      0 - scalar code
+      1 - SSE2
+      2 - AVX2
+**************************************************************************/
+int dft_simd_level(void)
+{
+#ifdef DFT_X86_SIMD
+   return(__builtin_cpu_supports("avx2") ? 2 : 1);
+#else
+   return(0);
+#endif
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: dft_dir_powers_waves - Applies all DFT wave forms to the pixel row
+#cat:             sums of one orientation.  Several wave forms are computed
+#cat:             side by side in SIMD registers, but each of them is still
+#cat:             accumulated in the same order as dft_power(), so the
+#cat:             resulting powers are identical to the scalar code.
+
+   Input:
+      dir      - the orientation the row sums were computed at
+      rowsums  - accumulated rows of pixels from within a rotated grid
+      dftwaves - structure containing the DFT wave forms, their
+                 interleaved table and the instruction set to use
+   Output:
+      powers   - DFT powers of each wave form at orientation dir
+**************************************************************************/
+#ifdef DFT_X86_SIMD
+__attribute__((target("avx2")))
+static int dft_dir_powers_waves_avx2(double **powers, const int dir,
+                                     const int *rowsums, const double *wavetab,
+                                     const int fw, const int nwaves,
+                                     const int wavelen)
+{
+   int i, w, k;
+   double power[4];
+
+   for(w = fw; w + 4 <= nwaves; w += 4){
+      __m256d cospart = _mm256_setzero_pd();
+      __m256d sinpart = _mm256_setzero_pd();
+
+      for(i = 0; i < wavelen; i++){
+         const double *row = wavetab + (i*2*nwaves) + w;
+         __m256d rowsum = _mm256_set1_pd((double)rowsums[i]);
+
+         cospart = _mm256_add_pd(cospart,
+                             _mm256_mul_pd(rowsum, _mm256_loadu_pd(row)));
+         sinpart = _mm256_add_pd(sinpart,
+                             _mm256_mul_pd(rowsum, _mm256_loadu_pd(row + nwaves)));
+      }
+
+      _mm256_storeu_pd(power, _mm256_add_pd(_mm256_mul_pd(cospart, cospart),
+                                            _mm256_mul_pd(sinpart, sinpart)));
+      for(k = 0; k < 4; k++)
+         powers[w+k][dir] = power[k];
+   }
+
+   return(w);
+}
+
+static int dft_dir_powers_waves_sse2(double **powers, const int dir,
+                                     const int *rowsums, const double *wavetab,
+                                     const int fw, const int nwaves,
+                                     const int wavelen)
+{
+   int i, w, k;
+   double power[2];
+
+   for(w = fw; w + 2 <= nwaves; w += 2){
+      __m128d cospart = _mm_setzero_pd();
+      __m128d sinpart = _mm_setzero_pd();
+
+      for(i = 0; i < wavelen; i++){
+         const double *row = wavetab + (i*2*nwaves) + w;
+         __m128d rowsum = _mm_set1_pd((double)rowsums[i]);
+
+         cospart = _mm_add_pd(cospart, _mm_mul_pd(rowsum, _mm_loadu_pd(row)));
+         sinpart = _mm_add_pd(sinpart,
+                              _mm_mul_pd(rowsum, _mm_loadu_pd(row + nwaves)));
+      }
+
+      _mm_storeu_pd(power, _mm_add_pd(_mm_mul_pd(cospart, cospart),
+                                      _mm_mul_pd(sinpart, sinpart)));
+      for(k = 0; k < 2; k++)
+         powers[w+k][dir] = power[k];
+   }
+
+   return(w);
+}
+#endif
+
+static void dft_dir_powers_waves(double **powers, const int dir,
+                                 const int *rowsums, const DFTWAVES *dftwaves)
+{
+   int w = 0;
+
+#ifdef DFT_X86_SIMD
+   if(dftwaves->simd > 1)
+      w = dft_dir_powers_waves_avx2(powers, dir, rowsums, dftwaves->wavetab,
+                                    w, dftwaves->nwaves, dftwaves->wavelen);
+   if(dftwaves->simd > 0)
+      w = dft_dir_powers_waves_sse2(powers, dir, rowsums, dftwaves->wavetab,
+                                    w, dftwaves->nwaves, dftwaves->wavelen);
+#endif
+
+   for(; w < dftwaves->nwaves; w++){
+      dft_power(&(powers[w][dir]), rowsums,
+                dftwaves->waves[w], dftwaves->wavelen);
+   }
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: dft_dir_powers_fixed - Same as dft_dir_powers(), but applies the DFT
+#cat:         wave forms in fixed point arithmetic.  This is a lot faster
+#cat:         on processors with weak floating point units, and the
+#cat:         powers only differ in their least significant bits.
+
+   Input:
+      pdata     - the padded input image
+      blkoffset - the pixel offset form the origin of the padded image to
+                  the origin of the current block in the image
+      pw        - the width (in pixels) of the padded input image
+      ph        - the height (in pixels) of the padded input image
+      dftwaves  - structure containing the DFT wave forms
+      dftgrids  - structure containing the rotated pixel grid offsets
+   Output:
+      powers    - DFT power computed from each wave form frequencies at each
+                  orientation (direction) in the current image block
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int dft_dir_powers_fixed(double **powers, unsigned char *pdata,
+               const int blkoffset, const int pw, const int ph,
+               const DFTWAVES *dftwaves, const ROTGRIDS *dftgrids)
+{
+   int w, dir;
+   int *rowsums;
+   unsigned char *blkptr;
+
+   /* This routine requires square block (grid), so ERROR otherwise. */
+   if(dftgrids->grid_w != dftgrids->grid_h){
+      fprintf(stderr,
+              "ERROR : dft_dir_powers_fixed : DFT grids must be square\n");
+      return(-91);
+   }
+   rowsums = (int *)g_malloc(dftgrids->grid_w * sizeof(int));
+
+   /* Foreach direction ... */
+   for(dir = 0; dir < dftgrids->ngrids; dir++){
+      /* Compute vector of line sums from rotated grid */
+      blkptr = pdata + blkoffset;
+      sum_rot_block_rows(rowsums, blkptr,
+                         dftgrids->grids[dir], dftgrids->grid_w);
+
+      /* Foreach DFT wave ... */
+      for(w = 0; w < dftwaves->nwaves; w++){
+         dft_power_fixed(&(powers[w][dir]), rowsums,
+                         dftwaves->waves[w], dftwaves->wavelen);
+      }
+   }
+
+   g_free(rowsums);
+
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: dft_power_fixed - Same as dft_power(), but uses the fixed point wave
+#cat:             forms and integer accumulators.
+
+   Input:
+      rowsums - accumulated rows of pixels from within a rotated grid
+                overlaying an input image block
+      wave    - the wave form (cosine and sine components) at a specific
+                frequency
+      wavelen - the length of the wave form (must match the height of the
+                image block which is the length of the rowsum vector)
+   Output:
+      power   - the computed DFT power for the given wave form at the
+                given orientation within the image block
+**************************************************************************/
+void dft_power_fixed(double *power, const int *rowsums,
+                     const DFTWAVE *wave, const int wavelen)
+{
+   int i;
+   gint64 cospart, sinpart;
+
+   /* Initialize accumulators */
+   cospart = 0;
+   sinpart = 0;
+
+   /* Accumulate cos and sin components of DFT. */
+   for(i = 0; i < wavelen; i++){
+      cospart += (gint64)rowsums[i] * wave->fixed_cos[i];
+      sinpart += (gint64)rowsums[i] * wave->fixed_sin[i];
+   }
+
+   /* Keep only half of the fraction bits, so that the squares of */
+   /* the components still fit into 64 bits.                      */
+   cospart = (cospart + (1 << (DFT_FIXED_BITS/2 - 1))) >> (DFT_FIXED_BITS/2);
+   sinpart = (sinpart + (1 << (DFT_FIXED_BITS/2 - 1))) >> (DFT_FIXED_BITS/2);
+
+   /* Power is the sum of the squared cos and sin components, scaled */
+   /* back to the range of dft_power(), which the power thresholds   */
+   /* in LFSPARMS are given in.                                      */
+   *power = (double)((cospart * cospart) + (sinpart * sinpart)) /
+            (double)DFT_FIXED_ONE;
+}
+
 /*************************************************************************
 **************************************************************************
 #cat: dft_power_stats - Derives statistics from a set of DFT power vectors.
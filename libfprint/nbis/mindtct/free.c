@@ -92,9 +92,12 @@ void free_dftwaves(DFTWAVES *dftwaves)
    for(i = 0; i < dftwaves->nwaves; i++){
        g_free(dftwaves->waves[i]->cos);
        g_free(dftwaves->waves[i]->sin);
+       g_free(dftwaves->waves[i]->fixed_cos);
+       g_free(dftwaves->waves[i]->fixed_sin);
        g_free(dftwaves->waves[i]);
    }
    g_free(dftwaves->waves);
+   g_free(dftwaves->wavetab);
    g_free(dftwaves);
 }
 
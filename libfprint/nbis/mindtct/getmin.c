@@ -62,8 +62,53 @@ of the software.
 ***********************************************************************/
 
 #include <stdio.h>
+#include <string.h>
 #include <lfs.h>
 
+/*************************************************************************
+**************************************************************************
+#cat: copy_minutiae - Makes a deep copy of a list of minutiae, allocated
+#cat:                with lfs_malloc().  This is used to move the detected
+#cat:                minutiae out of the arena used during the detection.
+
+   Input:
+      minutiae - the minutiae to copy
+   Return Code:
+      The copy of minutiae
+**************************************************************************/
+static MINUTIAE *copy_minutiae(const MINUTIAE *minutiae)
+{
+   MINUTIAE *copy;
+   MINUTIA *minutia;
+   int i;
+
+   copy = (MINUTIAE *)lfs_malloc(sizeof(MINUTIAE));
+   copy->alloc = max(minutiae->num, 1);
+   copy->num = minutiae->num;
+   copy->list = (MINUTIA **)lfs_malloc(copy->alloc * sizeof(MINUTIA *));
+
+   for(i = 0; i < minutiae->num; i++){
+      minutia = (MINUTIA *)lfs_malloc(sizeof(MINUTIA));
+      memcpy(minutia, minutiae->list[i], sizeof(MINUTIA));
+
+      if(minutia->nbrs != (int *)NULL){
+         minutia->nbrs = (int *)lfs_malloc(minutia->num_nbrs * sizeof(int));
+         memcpy(minutia->nbrs, minutiae->list[i]->nbrs,
+                minutia->num_nbrs * sizeof(int));
+      }
+      if(minutia->ridge_counts != (int *)NULL){
+         minutia->ridge_counts = (int *)lfs_malloc(minutia->num_nbrs *
+                                                   sizeof(int));
+         memcpy(minutia->ridge_counts, minutiae->list[i]->ridge_counts,
+                minutia->num_nbrs * sizeof(int));
+      }
+
+      copy->list[i] = minutia;
+   }
+
+   return(copy);
+}
+
 /*************************************************************************
 **************************************************************************
 #cat:   get_minutiae - Takes a grayscale fingerprint image, binarizes the input
@@ -105,12 +150,14 @@ int get_minutiae(MINUTIAE **ominutiae, int **oquality_map,
                  const int id, const double ppmm, const LFSPARMS *lfsparms)
 {
    int ret;
-   MINUTIAE *minutiae;
+   MINUTIAE *minutiae, *arena_minutiae;
+   LFSARENA *arena, *prev_arena;
    int *direction_map, *low_contrast_map, *low_flow_map;
    int *high_curve_map, *quality_map;
    int map_w, map_h;
    unsigned char *bdata;
    int bw, bh;
+   gint64 start;
 
    /* If input image is not 8-bit grayscale ... */
    if(id != 8){
@@ -119,15 +166,29 @@ int get_minutiae(MINUTIAE **ominutiae, int **oquality_map,
       return(-2);
    }
 
+   /* The detection does a lot of small, short lived allocations.  */
+   /* These are made from an arena that is released in one go, and */
+   /* only the resulting minutiae are copied out of it.             */
+   arena = new_lfs_arena();
+   prev_arena = set_lfs_arena(arena);
+
    /* Detect minutiae in grayscale fingerpeint image. */
-   if((ret = lfs_detect_minutiae_V2(&minutiae,
-                                   &direction_map, &low_contrast_map,
-                                   &low_flow_map, &high_curve_map,
-                                   &map_w, &map_h,
-                                   &bdata, &bw, &bh,
-                                   idata, iw, ih, lfsparms))){
+   ret = lfs_detect_minutiae_V2(&arena_minutiae,
+                                &direction_map, &low_contrast_map,
+                                &low_flow_map, &high_curve_map,
+                                &map_w, &map_h,
+                                &bdata, &bw, &bh,
+                                idata, iw, ih, lfsparms);
+
+   set_lfs_arena(prev_arena);
+   if(!ret)
+      minutiae = copy_minutiae(arena_minutiae);
+   free_lfs_arena(arena);
+
+   if(ret)
       return(ret);
-   }
+
+   start = lfs_stage_start();
 
    /* Build integrated quality map. */
    if((ret = gen_quality_map(&quality_map,
@@ -156,6 +217,8 @@ int get_minutiae(MINUTIAE **ominutiae, int **oquality_map,
       return(ret);
    }
 
+   lfs_stage_done(LFS_STAGE_QUALITY, start);
+
    /* Set output pointers. */
    *ominutiae = minutiae;
    *oquality_map = quality_map;
@@ -153,7 +153,13 @@ LFSPARMS g_lfsparms = {
 
    /* Ridge Counting Controls */
    MAX_NBRS,
-   MAX_RIDGE_STEPS
+   MAX_RIDGE_STEPS,
+
+   /* Arithmetic Controls */
+   FALSE,
+
+   /* Extraction Profile */
+   LFS_PROFILE_FULL
 };
 
 
@@ -237,7 +243,13 @@ LFSPARMS g_lfsparms_V2 = {
 
    /* Ridge Counting Controls */
    MAX_NBRS,
-   MAX_RIDGE_STEPS
+   MAX_RIDGE_STEPS,
+
+   /* Arithmetic Controls */
+   FALSE,
+
+   /* Extraction Profile */
+   LFS_PROFILE_FULL
 };
 
 /* Variables for conducting 8-connected neighbor analyses. */
@@ -312,3 +324,21 @@ FEATURE_PATTERN g_feature_patterns[]=
                          {0,1},
                          {1,0},
                          {0,1}}};
+
+/* Names of the timed detection stages, indexed by LFS_STAGE_*. */
+char *g_lfs_stage_names[NUM_LFS_STAGES] = {
+                        "maps",
+                        "binarize",
+                        "detect",
+                        "sort",
+                        "remove_islands_and_lakes",
+                        "remove_holes",
+                        "remove_pointing_invblock",
+                        "remove_near_invblock",
+                        "remove_or_adjust_side_minutiae",
+                        "remove_hooks",
+                        "remove_overlaps",
+                        "remove_malformations",
+                        "remove_pores",
+                        "count_minutiae_ridges",
+                        "quality"};
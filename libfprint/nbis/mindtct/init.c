@@ -63,9 +63,12 @@ of the software.
                         init_rotgrids()
                         alloc_dir_powers()
                         alloc_power_stats()
+                        get_lfs_setup()
+                        release_lfs_setup()
 ***********************************************************************/
 
 #include <stdio.h>
+#include <string.h>
 #include <lfs.h>
 
 /*************************************************************************
@@ -147,6 +150,7 @@ int init_dftwaves(DFTWAVES **optr, const double *dft_coefs,
    int i, j;
    double pi_factor, freq, x;
    double *cptr, *sptr;
+   int *fcptr, *fsptr;
 
    /* Allocate structure */
    dftwaves = (DFTWAVES *)g_malloc(sizeof(DFTWAVES));
@@ -178,10 +182,15 @@ int init_dftwaves(DFTWAVES **optr, const double *dft_coefs,
       dftwaves->waves[i]->cos = (double *)g_malloc(blocksize * sizeof(double));
       /* Allocate sine vector */
       dftwaves->waves[i]->sin = (double *)g_malloc(blocksize * sizeof(double));
+      /* Allocate fixed point cosine and sine vectors */
+      dftwaves->waves[i]->fixed_cos = (int *)g_malloc(blocksize * sizeof(int));
+      dftwaves->waves[i]->fixed_sin = (int *)g_malloc(blocksize * sizeof(int));
 
       /* Assign pointer nicknames */
       cptr = dftwaves->waves[i]->cos;
       sptr = dftwaves->waves[i]->sin;
+      fcptr = dftwaves->waves[i]->fixed_cos;
+      fsptr = dftwaves->waves[i]->fixed_sin;
 
       /* Compute actual frequency */
       freq = pi_factor * dft_coefs[i];
@@ -193,9 +202,24 @@ int init_dftwaves(DFTWAVES **optr, const double *dft_coefs,
          /* Store cos and sin components of sample point */
          *cptr++ = cos(x);
          *sptr++ = sin(x);
+         *fcptr++ = sround(cos(x) * DFT_FIXED_ONE);
+         *fsptr++ = sround(sin(x) * DFT_FIXED_ONE);
       }
    }
 
+   /* Interleave the wave forms, so that the cos and sin points of */
+   /* all waves at a given row are next to each other in memory.   */
+   dftwaves->wavetab = (double *)g_malloc(blocksize * nwaves * 2 *
+                                          sizeof(double));
+   for(j = 0; j < blocksize; j++){
+      for(i = 0; i < nwaves; i++){
+         dftwaves->wavetab[(j*2*nwaves) + i] = dftwaves->waves[i]->cos[j];
+         dftwaves->wavetab[(j*2*nwaves) + nwaves + i] =
+                                               dftwaves->waves[i]->sin[j];
+      }
+   }
+   dftwaves->simd = dft_simd_level();
+
    *optr = dftwaves;
    return(0);
 }
@@ -621,3 +645,164 @@ int alloc_power_stats(int **owis, double **opowmaxs, int **opowmax_dirs,
 
 
 
+
+/*************************************************************************
+**************************************************************************
+#cat: get_lfs_setup - Returns the lookup tables needed to detect minutiae
+#cat:                 in an image of the given width.  The tables are
+#cat:                 cached, so that they are only built for the first
+#cat:                 image of a width and set of parameters.  The cache
+#cat:                 can be used from several threads.
+
+   Input:
+      iw        - width (in pixels) of the image
+      maxpad    - padding (in pixels) of the image
+      lfsparms  - parameters and thresholds for controlling LFS
+   Output:
+      osetup    - points to the shared LFSSETUP structure, which must
+                  be released with release_lfs_setup()
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+G_LOCK_DEFINE_STATIC(lfs_setups);
+static LFSSETUP *lfs_setups[MAX_LFS_SETUPS];
+
+static void unref_lfs_setup(LFSSETUP *setup)
+{
+   /* Must be called with the lfs_setups lock held. */
+   if(--setup->ref_count > 0)
+      return;
+
+   free_dir2rad(setup->dir2rad);
+   free_dftwaves(setup->dftwaves);
+   free_rotgrids(setup->dftgrids);
+   free_rotgrids(setup->dirbingrids);
+   g_free(setup);
+}
+
+static int create_lfs_setup(LFSSETUP **osetup, const int iw,
+                            const int maxpad, const LFSPARMS *lfsparms)
+{
+   LFSSETUP *setup;
+   int ret;
+
+   setup = (LFSSETUP *)g_malloc0(sizeof(LFSSETUP));
+   setup->ref_count = 1;
+   setup->iw = iw;
+   setup->maxpad = maxpad;
+   setup->num_directions = lfsparms->num_directions;
+   setup->start_dir_angle = lfsparms->start_dir_angle;
+   setup->num_dft_waves = lfsparms->num_dft_waves;
+   setup->windowsize = lfsparms->windowsize;
+   setup->dirbin_grid_w = lfsparms->dirbin_grid_w;
+   setup->dirbin_grid_h = lfsparms->dirbin_grid_h;
+
+   /* Initialize lookup table for converting integer directions */
+   /* to angles in radians.                                     */
+   if((ret = init_dir2rad(&(setup->dir2rad), lfsparms->num_directions))){
+      g_free(setup);
+      return(ret);
+   }
+
+   /* Initialize wave form lookup tables for DFT analyses. */
+   if((ret = init_dftwaves(&(setup->dftwaves), g_dft_coefs,
+                        lfsparms->num_dft_waves, lfsparms->windowsize))){
+      free_dir2rad(setup->dir2rad);
+      g_free(setup);
+      return(ret);
+   }
+
+   /* Initialize lookup table for pixel offsets to rotated grids */
+   /* used for DFT analyses.  The image height is not needed.    */
+   if((ret = init_rotgrids(&(setup->dftgrids), iw, 0, maxpad,
+                        lfsparms->start_dir_angle, lfsparms->num_directions,
+                        lfsparms->windowsize, lfsparms->windowsize,
+                        RELATIVE2ORIGIN))){
+      free_dir2rad(setup->dir2rad);
+      free_dftwaves(setup->dftwaves);
+      g_free(setup);
+      return(ret);
+   }
+
+   /* Initialize lookup table for pixel offsets to rotated grids */
+   /* used for directional binarization.                         */
+   if((ret = init_rotgrids(&(setup->dirbingrids), iw, 0, maxpad,
+                        lfsparms->start_dir_angle, lfsparms->num_directions,
+                        lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h,
+                        RELATIVE2CENTER))){
+      free_dir2rad(setup->dir2rad);
+      free_dftwaves(setup->dftwaves);
+      free_rotgrids(setup->dftgrids);
+      g_free(setup);
+      return(ret);
+   }
+
+   *osetup = setup;
+   return(0);
+}
+
+int get_lfs_setup(LFSSETUP **osetup, const int iw, const int maxpad,
+                  const LFSPARMS *lfsparms)
+{
+   LFSSETUP *setup;
+   int i, ret;
+
+   G_LOCK(lfs_setups);
+
+   /* Search the cache, which is kept in most recently used order. */
+   for(i = 0; i < MAX_LFS_SETUPS && lfs_setups[i]; i++){
+      setup = lfs_setups[i];
+      if(setup->iw == iw &&
+         setup->maxpad == maxpad &&
+         setup->num_directions == lfsparms->num_directions &&
+         setup->start_dir_angle == lfsparms->start_dir_angle &&
+         setup->num_dft_waves == lfsparms->num_dft_waves &&
+         setup->windowsize == lfsparms->windowsize &&
+         setup->dirbin_grid_w == lfsparms->dirbin_grid_w &&
+         setup->dirbin_grid_h == lfsparms->dirbin_grid_h)
+         break;
+   }
+
+   if(i < MAX_LFS_SETUPS && lfs_setups[i]){
+      setup = lfs_setups[i];
+   }
+   else{
+      if((ret = create_lfs_setup(&setup, iw, maxpad, lfsparms))){
+         G_UNLOCK(lfs_setups);
+         return(ret);
+      }
+
+      /* Drop the least recently used setup if the cache is full. */
+      i = MAX_LFS_SETUPS - 1;
+      if(lfs_setups[i])
+         unref_lfs_setup(lfs_setups[i]);
+   }
+
+   /* Move the setup to the front. */
+   memmove(&lfs_setups[1], &lfs_setups[0], i * sizeof(LFSSETUP *));
+   lfs_setups[0] = setup;
+
+   /* One reference is held by the cache, one by the caller. */
+   setup->ref_count++;
+
+   G_UNLOCK(lfs_setups);
+
+   *osetup = setup;
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: release_lfs_setup - Releases the lookup tables returned by
+#cat:                 get_lfs_setup().
+
+   Input:
+      setup     - the LFSSETUP structure to release
+**************************************************************************/
+void release_lfs_setup(LFSSETUP *setup)
+{
+   G_LOCK(lfs_setups);
+   unref_lfs_setup(setup);
+   G_UNLOCK(lfs_setups);
+}
@@ -253,21 +253,198 @@ int gen_image_maps(int **odmap, int **olcmap, int **olfmap, int **ohcmap,
       Zero     - successful completion
       Negative - system error
 **************************************************************************/
+/* The blocks of the initial maps do not depend on each other, so the */
+/* image is split into rows of blocks that are processed by a pool of */
+/* worker threads.  Each block is computed exactly as in a serial     */
+/* pass, so the maps do not depend on the number of threads.          */
+typedef struct initmaps{
+   int *direction_map;
+   int *low_contrast_map;
+   int *low_flow_map;
+   int *blkoffs;
+   int mw, mh;
+   unsigned char *pdata;
+   int pw, ph;
+   const DFTWAVES *dftwaves;
+   const ROTGRIDS *dftgrids;
+   const LFSPARMS *lfsparms;
+
+   /* Accessed atomically by the workers */
+   int next_row;
+   int error_row;
+
+   GMutex lock;
+   int ret;
+   int ret_block;
+} INITMAPS;
+
+static int gen_initial_maps_block(INITMAPS *job, const int bi,
+                double **powers, int *wis, double *powmaxs,
+                int *powmax_dirs, double *pownorms, const int nstats)
+{
+   const LFSPARMS *lfsparms = job->lfsparms;
+   const int pw = job->pw;
+   int ret, blkdir;
+   int dft_offset;
+   int xminlimit, xmaxlimit, yminlimit, ymaxlimit;
+   int win_x, win_y, low_contrast_offset;
+
+   /* Compute special window origin limits for determining low contrast.  */
+   /* These pixel limits avoid analyzing the padded borders of the image. */
+   xminlimit = job->dftgrids->pad;
+   yminlimit = job->dftgrids->pad;
+   xmaxlimit = pw - job->dftgrids->pad - lfsparms->windowsize - 1;
+   ymaxlimit = job->ph - job->dftgrids->pad - lfsparms->windowsize - 1;
+
+   /* Adjust block offset from pointing to block origin to pointing */
+   /* to surrounding window origin.                                 */
+   dft_offset = job->blkoffs[bi] - (lfsparms->windowoffset * pw) -
+                   lfsparms->windowoffset;
+
+   /* Compute pixel coords of window origin. */
+   win_x = dft_offset % pw;
+   win_y = (int)(dft_offset / pw);
+
+   /* Make sure the current window does not access padded image pixels */
+   /* for analyzing low contrast.                                      */
+   win_x = max(xminlimit, win_x);
+   win_x = min(xmaxlimit, win_x);
+   win_y = max(yminlimit, win_y);
+   win_y = min(ymaxlimit, win_y);
+   low_contrast_offset = (win_y * pw) + win_x;
+
+   print2log("   BLOCK %2d (%2d, %2d) ", bi, bi%job->mw, bi/job->mw);
+
+   /* If block is low contrast ... */
+   if((ret = low_contrast_block(low_contrast_offset, lfsparms->windowsize,
+                               job->pdata, pw, job->ph, lfsparms))){
+      /* If system error ... */
+      if(ret < 0)
+         return(ret);
+
+      /* Otherwise, block is low contrast ... */
+      print2log("LOW CONTRAST\n");
+      job->low_contrast_map[bi] = TRUE;
+      /* Direction Map's block is already set to INVALID. */
+      return(0);
+   }
+
+   /* Otherwise, sufficient contrast for DFT processing ... */
+   print2log("\n");
+
+   /* Compute DFT powers */
+   if(lfsparms->fixed_point)
+      ret = dft_dir_powers_fixed(powers, job->pdata, low_contrast_offset, pw,
+                                 job->ph, job->dftwaves, job->dftgrids);
+   else
+      ret = dft_dir_powers(powers, job->pdata, low_contrast_offset, pw,
+                           job->ph, job->dftwaves, job->dftgrids);
+   if(ret)
+      return(ret);
+
+   /* Compute DFT power statistics, skipping first applied DFT  */
+   /* wave.  This is dependent on how the primary and secondary */
+   /* direction tests work below.                               */
+   if((ret = dft_power_stats(wis, powmaxs, powmax_dirs, pownorms, powers,
+                          1, job->dftwaves->nwaves, job->dftgrids->ngrids)))
+      return(ret);
+
+#ifdef LOG_REPORT /*vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv*/
+   {  int _w;
+      fprintf(logfp, "      Power\n");
+      for(_w = 0; _w < nstats; _w++){
+         /* Add 1 to wis[w] to create index to original g_dft_coefs[] */
+         fprintf(logfp, "         wis[%d] %d %12.3f %2d %9.3f %12.3f\n",
+              _w, wis[_w]+1,
+              powmaxs[wis[_w]], powmax_dirs[wis[_w]], pownorms[wis[_w]],
+              powers[0][powmax_dirs[wis[_w]]]);
+      }
+   }
+#endif /*^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^*/
+
+   /* Conduct primary direction test */
+   blkdir = primary_dir_test(powers, wis, powmaxs, powmax_dirs,
+                            pownorms, nstats, lfsparms);
+
+   if(blkdir != INVALID_DIR)
+      job->direction_map[bi] = blkdir;
+   else{
+      /* Conduct secondary (fork) direction test */
+      blkdir = secondary_fork_test(powers, wis, powmaxs, powmax_dirs,
+                            pownorms, nstats, lfsparms);
+      if(blkdir != INVALID_DIR)
+         job->direction_map[bi] = blkdir;
+      /* Otherwise current direction in Direction Map remains INVALID */
+      else
+         /* Flag the block as having LOW RIDGE FLOW. */
+         job->low_flow_map[bi] = TRUE;
+   }
+
+   return(0);
+}
+
+static void gen_initial_maps_worker(void *data)
+{
+   INITMAPS *job = (INITMAPS *)data;
+   int *wis, *powmax_dirs;
+   double **powers, *powmaxs, *pownorms;
+   int nstats;
+   int row, ret;
+   int bi = 0;
+
+   /* Allocate DFT directional power vectors */
+   if(!(ret = alloc_dir_powers(&powers, job->dftwaves->nwaves,
+                               job->dftgrids->ngrids))){
+      /* Allocate DFT power statistic arrays */
+      /* Compute length of statistics arrays.  Statistics not needed   */
+      /* for the first DFT wave, so the length is number of waves - 1. */
+      nstats = job->dftwaves->nwaves - 1;
+      if((ret = alloc_power_stats(&wis, &powmaxs, &powmax_dirs,
+                               &pownorms, nstats))){
+         free_dir_powers(powers, job->dftwaves->nwaves);
+      }
+      else{
+         while(!ret){
+            /* Claim the next row of blocks.  Rows are claimed in order, */
+            /* so every row before a failing one is always completed.    */
+            row = g_atomic_int_add(&job->next_row, 1);
+            if(row >= job->mh || row > g_atomic_int_get(&job->error_row))
+               break;
+
+            for(bi = row * job->mw; bi < (row + 1) * job->mw; bi++){
+               if((ret = gen_initial_maps_block(job, bi, powers, wis,
+                                    powmaxs, powmax_dirs, pownorms, nstats)))
+                  break;
+            }
+         }
+
+         /* Deallocate working memory */
+         free_dir_powers(powers, job->dftwaves->nwaves);
+         g_free(wis);
+         g_free(powmaxs);
+         g_free(powmax_dirs);
+         g_free(pownorms);
+      }
+   }
+
+   g_mutex_lock(&job->lock);
+   /* Report the error of the first failing block, like a serial pass. */
+   if(ret && bi < job->ret_block){
+      job->ret = ret;
+      job->ret_block = bi;
+      g_atomic_int_set(&job->error_row, bi / job->mw);
+   }
+   g_mutex_unlock(&job->lock);
+}
+
 int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
                 int *blkoffs, const int mw, const int mh,
                 unsigned char *pdata, const int pw, const int ph,
                 const DFTWAVES *dftwaves, const  ROTGRIDS *dftgrids,
                 const LFSPARMS *lfsparms)
 {
-   int *direction_map, *low_contrast_map, *low_flow_map;
-   int bi, bsize, blkdir;
-   int *wis, *powmax_dirs;
-   double **powers, *powmaxs, *pownorms;
-   int nstats;
-   int ret; /* return code */
-   int dft_offset;
-   int xminlimit, xmaxlimit, yminlimit, ymaxlimit;
-   int win_x, win_y, low_contrast_offset;
+   INITMAPS job;
+   int bsize, nworkers;
 
    print2log("INITIAL MAP\n");
 
@@ -275,173 +452,55 @@ int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
    ASSERT_INT_MUL(mw, mh);
    bsize = mw * mh;
 
+   job.blkoffs = blkoffs;
+   job.mw = mw;
+   job.mh = mh;
+   job.pdata = pdata;
+   job.pw = pw;
+   job.ph = ph;
+   job.dftwaves = dftwaves;
+   job.dftgrids = dftgrids;
+   job.lfsparms = lfsparms;
+   job.next_row = 0;
+   job.error_row = G_MAXINT;
+   job.ret = 0;
+   job.ret_block = G_MAXINT;
+
    /* Allocate Direction Map memory */
-   direction_map = (int *)g_malloc(bsize * sizeof(int));
+   job.direction_map = (int *)g_malloc(bsize * sizeof(int));
    /* Initialize the Direction Map to INVALID (-1). */
-   memset(direction_map, INVALID_DIR, bsize * sizeof(int));
+   memset(job.direction_map, INVALID_DIR, bsize * sizeof(int));
 
    /* Allocate Low Contrast Map memory */
-   low_contrast_map = (int *)g_malloc(bsize * sizeof(int));
+   job.low_contrast_map = (int *)g_malloc(bsize * sizeof(int));
    /* Initialize the Low Contrast Map to FALSE (0). */
-   memset(low_contrast_map, 0, bsize * sizeof(int));
+   memset(job.low_contrast_map, 0, bsize * sizeof(int));
 
    /* Allocate Low Ridge Flow Map memory */
-   low_flow_map = (int *)g_malloc(bsize * sizeof(int));
+   job.low_flow_map = (int *)g_malloc(bsize * sizeof(int));
    /* Initialize the Low Flow Map to FALSE (0). */
-   memset(low_flow_map, 0, bsize * sizeof(int));
+   memset(job.low_flow_map, 0, bsize * sizeof(int));
 
-   /* Allocate DFT directional power vectors */
-   if((ret = alloc_dir_powers(&powers, dftwaves->nwaves, dftgrids->ngrids))){
-      /* Free memory allocated to this point. */
-      g_free(direction_map);
-      g_free(low_contrast_map);
-      g_free(low_flow_map);
-      return(ret);
-   }
+   /* Foreach row of blocks in image, with the calling thread as one */
+   /* of the workers.                                                */
+   nworkers = min(g_get_num_processors(), mh);
+   g_mutex_init(&job.lock);
 
-   /* Allocate DFT power statistic arrays */
-   /* Compute length of statistics arrays.  Statistics not needed   */
-   /* for the first DFT wave, so the length is number of waves - 1. */
-   nstats = dftwaves->nwaves - 1;
-   if((ret = alloc_power_stats(&wis, &powmaxs, &powmax_dirs,
-                            &pownorms, nstats))){
-      /* Free memory allocated to this point. */
-      g_free(direction_map);
-      g_free(low_contrast_map);
-      g_free(low_flow_map);
-      free_dir_powers(powers, dftwaves->nwaves);
-      return(ret);
-   }
+   run_lfs_workers(gen_initial_maps_worker, &job, nworkers);
 
-   /* Compute special window origin limits for determining low contrast.  */
-   /* These pixel limits avoid analyzing the padded borders of the image. */
-   xminlimit = dftgrids->pad;
-   yminlimit = dftgrids->pad;
-   xmaxlimit = pw - dftgrids->pad - lfsparms->windowsize - 1;
-   ymaxlimit = ph - dftgrids->pad - lfsparms->windowsize - 1;
-
-   /* Foreach block in image ... */
-   for(bi = 0; bi < bsize; bi++){
-      /* Adjust block offset from pointing to block origin to pointing */
-      /* to surrounding window origin.                                 */
-      dft_offset = blkoffs[bi] - (lfsparms->windowoffset * pw) -
-                      lfsparms->windowoffset;
-
-      /* Compute pixel coords of window origin. */
-      win_x = dft_offset % pw;
-      win_y = (int)(dft_offset / pw);
-
-      /* Make sure the current window does not access padded image pixels */
-      /* for analyzing low contrast.                                      */
-      win_x = max(xminlimit, win_x);
-      win_x = min(xmaxlimit, win_x);
-      win_y = max(yminlimit, win_y);
-      win_y = min(ymaxlimit, win_y);
-      low_contrast_offset = (win_y * pw) + win_x;
-
-      print2log("   BLOCK %2d (%2d, %2d) ", bi, bi%mw, bi/mw);
-
-      /* If block is low contrast ... */
-      if((ret = low_contrast_block(low_contrast_offset, lfsparms->windowsize,
-                                  pdata, pw, ph, lfsparms))){
-         /* If system error ... */
-         if(ret < 0){
-            g_free(direction_map);
-            g_free(low_contrast_map);
-            g_free(low_flow_map);
-            free_dir_powers(powers, dftwaves->nwaves);
-            g_free(wis);
-            g_free(powmaxs);
-            g_free(powmax_dirs);
-            g_free(pownorms);
-            return(ret);
-         }
-
-         /* Otherwise, block is low contrast ... */
-         print2log("LOW CONTRAST\n");
-         low_contrast_map[bi] = TRUE;
-         /* Direction Map's block is already set to INVALID. */
-      }
-      /* Otherwise, sufficient contrast for DFT processing ... */
-      else {
-         print2log("\n");
-
-         /* Compute DFT powers */
-         if((ret = dft_dir_powers(powers, pdata, low_contrast_offset, pw, ph,
-                               dftwaves, dftgrids))){
-            /* Free memory allocated to this point. */
-            g_free(direction_map);
-            g_free(low_contrast_map);
-            g_free(low_flow_map);
-            free_dir_powers(powers, dftwaves->nwaves);
-            g_free(wis);
-            g_free(powmaxs);
-            g_free(powmax_dirs);
-            g_free(pownorms);
-            return(ret);
-         }
-
-         /* Compute DFT power statistics, skipping first applied DFT  */
-         /* wave.  This is dependent on how the primary and secondary */
-         /* direction tests work below.                               */
-         if((ret = dft_power_stats(wis, powmaxs, powmax_dirs, pownorms, powers,
-                                1, dftwaves->nwaves, dftgrids->ngrids))){
-            /* Free memory allocated to this point. */
-            g_free(direction_map);
-            g_free(low_contrast_map);
-            g_free(low_flow_map);
-            free_dir_powers(powers, dftwaves->nwaves);
-            g_free(wis);
-            g_free(powmaxs);
-            g_free(powmax_dirs);
-            g_free(pownorms);
-            return(ret);
-         }
-
-#ifdef LOG_REPORT /*vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv*/
-         {  int _w;
-            fprintf(logfp, "      Power\n");
-            for(_w = 0; _w < nstats; _w++){
-               /* Add 1 to wis[w] to create index to original g_dft_coefs[] */
-               fprintf(logfp, "         wis[%d] %d %12.3f %2d %9.3f %12.3f\n",
-                    _w, wis[_w]+1,
-                    powmaxs[wis[_w]], powmax_dirs[wis[_w]], pownorms[wis[_w]],
-                    powers[0][powmax_dirs[wis[_w]]]);
-            }
-         }
-#endif /*^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^*/
+   g_mutex_clear(&job.lock);
 
-         /* Conduct primary direction test */
-         blkdir = primary_dir_test(powers, wis, powmaxs, powmax_dirs,
-                                  pownorms, nstats, lfsparms);
-
-         if(blkdir != INVALID_DIR)
-            direction_map[bi] = blkdir;
-         else{
-            /* Conduct secondary (fork) direction test */
-            blkdir = secondary_fork_test(powers, wis, powmaxs, powmax_dirs,
-                                  pownorms, nstats, lfsparms);
-            if(blkdir != INVALID_DIR)
-               direction_map[bi] = blkdir;
-            /* Otherwise current direction in Direction Map remains INVALID */
-            else
-               /* Flag the block as having LOW RIDGE FLOW. */
-               low_flow_map[bi] = TRUE;
-         }
-
-      } /* End DFT */
-   } /* bi */
-
-   /* Deallocate working memory */
-   free_dir_powers(powers, dftwaves->nwaves);
-   g_free(wis);
-   g_free(powmaxs);
-   g_free(powmax_dirs);
-   g_free(pownorms);
+   if(job.ret){
+      /* Free memory allocated to this point. */
+      g_free(job.direction_map);
+      g_free(job.low_contrast_map);
+      g_free(job.low_flow_map);
+      return(job.ret);
+   }
 
-   *odmap = direction_map;
-   *olcmap = low_contrast_map;
-   *olfmap = low_flow_map;
+   *odmap = job.direction_map;
+   *olcmap = job.low_contrast_map;
+   *olfmap = job.low_flow_map;
    return(0);
 }
 
@@ -72,6 +72,11 @@ of the software.
                         free_minutiae()
                         free_minutia()
                         remove_minutia()
+                        alloc_minutia_grid()
+                        free_minutia_grid()
+                        add_grid_minutia()
+                        remove_grid_minutia()
+                        find_grid_minutiae()
                         join_minutia()
                         minutia_type()
                         is_minutia_appearing()
@@ -118,8 +123,8 @@ int alloc_minutiae(MINUTIAE **ominutiae, const int DEFAULT_BOZORTH_MINUTIAE)
 {
    MINUTIAE *minutiae;
 
-   minutiae = (MINUTIAE *)g_malloc(sizeof(MINUTIAE));
-   minutiae->list = (MINUTIA **)g_malloc(DEFAULT_BOZORTH_MINUTIAE * sizeof(MINUTIA *));
+   minutiae = (MINUTIAE *)lfs_malloc(sizeof(MINUTIAE));
+   minutiae->list = (MINUTIA **)lfs_malloc(DEFAULT_BOZORTH_MINUTIAE * sizeof(MINUTIA *));
 
    minutiae->alloc = DEFAULT_BOZORTH_MINUTIAE;
    minutiae->num = 0;
@@ -146,8 +151,8 @@ int alloc_minutiae(MINUTIAE **ominutiae, const int DEFAULT_BOZORTH_MINUTIAE)
 int realloc_minutiae(MINUTIAE *minutiae, const int incr_minutiae)
 {
    minutiae->alloc += incr_minutiae;
-   minutiae->list = (MINUTIA **)g_realloc(minutiae->list,
-                                          minutiae->alloc * sizeof(MINUTIA *));
+   minutiae->list = (MINUTIA **)lfs_realloc(minutiae->list,
+                                            minutiae->alloc * sizeof(MINUTIA *));
 
    return(0);
 }
@@ -204,8 +209,9 @@ int detect_minutiae_V2(MINUTIAE *minutiae,
             const int mw, const int mh,
             const LFSPARMS *lfsparms)
 {
-   int ret;
+   int ret, i;
    int *pdirection_map, *plow_flow_map, *phigh_curve_map;
+   MINUTIAGRID *grid;
 
    /* Pixelize the maps by assigning block values to individual pixels. */
    if((ret = pixelize_map(&pdirection_map, iw, ih, direction_map, mw, mh,
@@ -226,16 +232,30 @@ int detect_minutiae_V2(MINUTIAE *minutiae,
       return(ret);
    }
 
-   if((ret = scan4minutiae_horizontally_V2(minutiae, bdata, iw, ih,
+   /* Grid of the minutiae, to compare new ones only to those close by. */
+   /* Cells of "max_minutia_delta" pixels limit the look up to 4 cells. */
+   if((ret = alloc_minutia_grid(&grid, iw, ih,
+                               lfsparms->max_minutia_delta))){
+      g_free(pdirection_map);
+      g_free(plow_flow_map);
+      g_free(phigh_curve_map);
+      return(ret);
+   }
+   for(i = 0; i < minutiae->num; i++)
+      add_grid_minutia(grid, minutiae->list[i]);
+
+   if((ret = scan4minutiae_horizontally_V2(minutiae, grid, bdata, iw, ih,
                  pdirection_map, plow_flow_map, phigh_curve_map, lfsparms))){
+      free_minutia_grid(grid);
       g_free(pdirection_map);
       g_free(plow_flow_map);
       g_free(phigh_curve_map);
       return(ret);
    }
 
-   if((ret = scan4minutiae_vertically_V2(minutiae, bdata, iw, ih,
+   if((ret = scan4minutiae_vertically_V2(minutiae, grid, bdata, iw, ih,
                  pdirection_map, plow_flow_map, phigh_curve_map, lfsparms))){
+      free_minutia_grid(grid);
       g_free(pdirection_map);
       g_free(plow_flow_map);
       g_free(phigh_curve_map);
@@ -243,6 +263,7 @@ int detect_minutiae_V2(MINUTIAE *minutiae,
    }
 
    /* Deallocate working memories. */
+   free_minutia_grid(grid);
    g_free(pdirection_map);
    g_free(plow_flow_map);
    g_free(phigh_curve_map);
@@ -376,7 +397,8 @@ int update_minutiae(MINUTIAE *minutiae, MINUTIA *minutia,
 #cat: update_minutiae_V2 - Takes a detected minutia point and (if it is not
 #cat:                determined to already be in the minutiae list or the
 #cat:                new point is determined to be "more compatible") adds
-#cat:                it to the list.
+#cat:                it to the list.  Only the minutiae close to the new
+#cat:                point are looked at, using a grid of the list.
 
    Input:
       minutia   - minutia structure for detected point
@@ -388,12 +410,14 @@ int update_minutiae(MINUTIAE *minutiae, MINUTIA *minutia,
       lfsparms  - parameters and thresholds for controlling LFS
    Output:
       minutiae   - points to a list of detected minutia structures
+      grid       - grid of the minutiae in the list
    Return Code:
       Zero      - minutia added to successfully added to minutiae list
       IGNORE    - minutia is to be ignored (already in the minutiae list)
       Negative  - system error
 **************************************************************************/
-int update_minutiae_V2(MINUTIAE *minutiae, MINUTIA *minutia,
+int update_minutiae_V2(MINUTIAE *minutiae, MINUTIAGRID *grid,
+                   MINUTIA *minutia,
                    const int scan_dir, const int dmapval,
                    unsigned char *bdata, const int iw, const int ih,
                    const LFSPARMS *lfsparms)
@@ -401,6 +425,8 @@ int update_minutiae_V2(MINUTIAE *minutiae, MINUTIA *minutia,
    int i, ret, dy, dx, delta_dir;
    int qtr_ndirs, full_ndirs;
    int map_scan_dir;
+   int f, nfound, node;
+   MINUTIA *nbr;
 
    /* Check to see if minutiae list is full ... if so, then extend */
    /* the length of the allocated list of minutia points.          */
@@ -418,25 +444,31 @@ int update_minutiae_V2(MINUTIAE *minutiae, MINUTIA *minutia,
    /* Compute number of directions in full circle. */
    full_ndirs = lfsparms->num_directions<<1;
 
-   /* Is the minutiae list empty? */
-   if(minutiae->num > 0){
-      /* Foreach minutia stored in the list (in reverse order) ... */
-      for(i = minutiae->num-1; i >= 0; i--){
+   /* Find the minutiae stored in the list that are sufficiently close */
+   /* in x and y, in the reverse order of the list.                    */
+   nfound = find_grid_minutiae(grid, minutia->x, minutia->y,
+                               lfsparms->max_minutia_delta);
+
+   /* Are there any close minutiae in the list? */
+   if(nfound > 0){
+      /* Foreach close minutia stored in the list (in reverse order) ... */
+      for(f = 0; f < nfound; f++){
+         node = grid->found[f];
+         nbr = grid->nodes[node].minutia;
          /* If x distance between new minutia and current list minutia */
          /* are sufficiently close...                                 */
-         dx = abs(minutiae->list[i]->x - minutia->x);
+         dx = abs(nbr->x - minutia->x);
          if(dx < lfsparms->max_minutia_delta){
             /* If y distance between new minutia and current list minutia */
             /* are sufficiently close...                                 */
-            dy = abs(minutiae->list[i]->y - minutia->y);
+            dy = abs(nbr->y - minutia->y);
             if(dy < lfsparms->max_minutia_delta){
                /* If new minutia and current list minutia are same type... */
-               if(minutiae->list[i]->type == minutia->type){
+               if(nbr->type == minutia->type){
                   /* Test to see if minutiae have similar directions. */
                   /* Take minimum of computed inner and outer        */
                   /* direction differences.                          */
-                  delta_dir = abs(minutiae->list[i]->direction -
-                                  minutia->direction);
+                  delta_dir = abs(nbr->direction - minutia->direction);
                   delta_dir = min(delta_dir, full_ndirs-delta_dir);
                   /* If directional difference is <= 45 degrees... */
                   if(delta_dir <= qtr_ndirs){
@@ -453,13 +485,11 @@ int update_minutiae_V2(MINUTIAE *minutiae, MINUTIA *minutia,
                      /* If new minutia point found on contour...        */
                      if(search_contour(minutia->x, minutia->y,
                                lfsparms->max_minutia_delta,
-                               minutiae->list[i]->x, minutiae->list[i]->y,
-                               minutiae->list[i]->ex, minutiae->list[i]->ey,
+                               nbr->x, nbr->y, nbr->ex, nbr->ey,
                                SCAN_CLOCKWISE, bdata, iw, ih) ||
                         search_contour(minutia->x, minutia->y,
                                lfsparms->max_minutia_delta,
-                               minutiae->list[i]->x, minutiae->list[i]->y,
-                               minutiae->list[i]->ex, minutiae->list[i]->ey,
+                               nbr->x, nbr->y, nbr->ex, nbr->ey,
                                SCAN_COUNTER_CLOCKWISE, bdata, iw, ih)){
                         /* If new minutia has VALID block direction ... */
                         if(dmapval >= 0){
@@ -472,6 +502,10 @@ int update_minutiae_V2(MINUTIAE *minutiae, MINUTIA *minutia,
                            if(map_scan_dir == scan_dir){
                               /* Then choose the new minutia over the one */
                               /* currently in the list.                   */
+                              for(i = minutiae->num-1; i >= 0; i--)
+                                 if(minutiae->list[i] == nbr)
+                                    break;
+                              remove_grid_minutia(grid, node);
                               if((ret = remove_minutia(i, minutiae))){
                                  return(ret);
                               }
@@ -509,6 +543,7 @@ int update_minutiae_V2(MINUTIAE *minutiae, MINUTIA *minutia,
    /* were close neighbors were selectively removed, so add it.       */
    minutiae->list[minutiae->num] = minutia;
    (minutiae->num)++;
+   add_grid_minutia(grid, minutia);
 
    /* New minutia was successfully added to the list. */
    /* Return normally. */
@@ -551,14 +586,14 @@ int sort_minutiae_y_x(MINUTIAE *minutiae, const int iw, const int ih)
    }
 
    /* Allocate new MINUTIA list to hold sorted minutiae. */
-   newlist = (MINUTIA **)g_malloc(minutiae->num * sizeof(MINUTIA *));
+   newlist = (MINUTIA **)lfs_malloc(minutiae->num * sizeof(MINUTIA *));
 
    /* Put minutia into sorted order in new list. */
    for(i = 0; i < minutiae->num; i++)
       newlist[i] = minutiae->list[order[i]];
 
    /* Deallocate non-sorted list of minutia pointers. */
-   g_free(minutiae->list);
+   lfs_free(minutiae->list);
    /* Assign new sorted list of minutia to minutiae list. */
    minutiae->list = newlist;
 
@@ -606,14 +641,14 @@ int sort_minutiae_x_y(MINUTIAE *minutiae, const int iw, const int ih)
    }
 
    /* Allocate new MINUTIA list to hold sorted minutiae. */
-   newlist = (MINUTIA **)g_malloc(minutiae->num * sizeof(MINUTIA *));
+   newlist = (MINUTIA **)lfs_malloc(minutiae->num * sizeof(MINUTIA *));
 
    /* Put minutia into sorted order in new list. */
    for(i = 0; i < minutiae->num; i++)
       newlist[i] = minutiae->list[order[i]];
 
    /* Deallocate non-sorted list of minutia pointers. */
-   g_free(minutiae->list);
+   lfs_free(minutiae->list);
    /* Assign new sorted list of minutia to minutiae list. */
    minutiae->list = newlist;
 
@@ -732,7 +767,7 @@ int create_minutia(MINUTIA **ominutia, const int x_loc, const int y_loc,
    MINUTIA *minutia;
 
    /* Allocate a minutia structure. */
-   minutia = (MINUTIA *)g_malloc(sizeof(MINUTIA));
+   minutia = (MINUTIA *)lfs_malloc(sizeof(MINUTIA));
 
    /* Assign minutia structure attributes. */
    minutia->x = x_loc;
@@ -770,10 +805,10 @@ void free_minutiae(MINUTIAE *minutiae)
    for(i = 0; i < minutiae->num; i++)
       free_minutia(minutiae->list[i]);
    /* Deallocate list of minutia pointers. */
-   g_free(minutiae->list);
+   lfs_free(minutiae->list);
 
    /* Deallocate the list structure. */
-   g_free(minutiae);
+   lfs_free(minutiae);
 }
 
 /*************************************************************************
@@ -788,12 +823,12 @@ void free_minutia(MINUTIA *minutia)
 {
    /* Deallocate sublists. */
    if(minutia->nbrs != (int *)NULL)
-      g_free(minutia->nbrs);
+      lfs_free(minutia->nbrs);
    if(minutia->ridge_counts != (int *)NULL)
-      g_free(minutia->ridge_counts);
+      lfs_free(minutia->ridge_counts);
 
    /* Deallocate the minutia structure. */
-   g_free(minutia);
+   lfs_free(minutia);
 }
 
 /*************************************************************************
@@ -835,6 +870,184 @@ int remove_minutia(const int index, MINUTIAE *minutiae)
    return(0);
 }
 
+/*************************************************************************
+**************************************************************************
+#cat: alloc_minutia_grid - Allocates an empty grid for looking up the
+#cat:                  minutiae of a list by their location in the image.
+
+   Input:
+      iw        - width (in pixels) of image
+      ih        - height (in pixels) of image
+      cell_size - width and height (in pixels) of a grid cell
+   Output:
+      ogrid     - points to the allocated grid
+   Return Code:
+      Zero      - successful completion
+      Negative  - system error
+**************************************************************************/
+int alloc_minutia_grid(MINUTIAGRID **ogrid, const int iw, const int ih,
+                       const int cell_size)
+{
+   MINUTIAGRID *grid;
+   int i, ncells;
+
+   grid = (MINUTIAGRID *)lfs_malloc(sizeof(MINUTIAGRID));
+   grid->cell_size = max(cell_size, 1);
+   grid->gw = max((iw + grid->cell_size - 1) / grid->cell_size, 1);
+   grid->gh = max((ih + grid->cell_size - 1) / grid->cell_size, 1);
+
+   /* All cells start out empty. */
+   ncells = grid->gw * grid->gh;
+   grid->cells = (int *)lfs_malloc(ncells * sizeof(int));
+   for(i = 0; i < ncells; i++)
+      grid->cells[i] = -1;
+
+   grid->alloc_nodes = MAX_MINUTIAE;
+   grid->num_nodes = 0;
+   grid->nodes = (MINUTIAGRIDNODE *)lfs_malloc(grid->alloc_nodes *
+                                               sizeof(MINUTIAGRIDNODE));
+   grid->found = (int *)lfs_malloc(grid->alloc_nodes * sizeof(int));
+
+   *ogrid = grid;
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: free_minutia_grid - Deallocates a minutia grid.  The minutiae in it
+#cat:                  are not deallocated.
+
+   Input:
+      grid      - the grid to deallocate
+**************************************************************************/
+void free_minutia_grid(MINUTIAGRID *grid)
+{
+   lfs_free(grid->found);
+   lfs_free(grid->nodes);
+   lfs_free(grid->cells);
+   lfs_free(grid);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: minutia_grid_cell - Returns the index of the grid cell a point is
+#cat:                  in, with points outside the image put in the
+#cat:                  closest cell.
+**************************************************************************/
+static int minutia_grid_cell(const MINUTIAGRID *grid, const int x, const int y)
+{
+   int cx, cy;
+
+   cx = min(max(x, 0) / grid->cell_size, grid->gw - 1);
+   cy = min(max(y, 0) / grid->cell_size, grid->gh - 1);
+
+   return((cy * grid->gw) + cx);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: add_grid_minutia - Adds a minutia to a grid, as the most recent one.
+
+   Input:
+      grid      - the grid to add to
+      minutia   - the minutia, whose location must not change while it
+                  is in the grid
+**************************************************************************/
+void add_grid_minutia(MINUTIAGRID *grid, MINUTIA *minutia)
+{
+   int node, cell;
+
+   if(grid->num_nodes >= grid->alloc_nodes){
+      grid->alloc_nodes += MAX_MINUTIAE;
+      grid->nodes = (MINUTIAGRIDNODE *)lfs_realloc(grid->nodes,
+                          grid->alloc_nodes * sizeof(MINUTIAGRIDNODE));
+      grid->found = (int *)lfs_realloc(grid->found,
+                          grid->alloc_nodes * sizeof(int));
+   }
+
+   node = grid->num_nodes++;
+   cell = minutia_grid_cell(grid, minutia->x, minutia->y);
+
+   grid->nodes[node].minutia = minutia;
+   grid->nodes[node].next = grid->cells[cell];
+   grid->cells[cell] = node;
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: remove_grid_minutia - Removes a node, as returned by
+#cat:                  find_grid_minutiae(), from a grid.  This must be
+#cat:                  done before its minutia is deallocated.
+
+   Input:
+      grid      - the grid to remove from
+      node      - the node of the minutia to remove
+**************************************************************************/
+void remove_grid_minutia(MINUTIAGRID *grid, const int node)
+{
+   MINUTIA *minutia;
+   int *link;
+
+   minutia = grid->nodes[node].minutia;
+   link = &grid->cells[minutia_grid_cell(grid, minutia->x, minutia->y)];
+   while(*link != node)
+      link = &grid->nodes[*link].next;
+   *link = grid->nodes[node].next;
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: find_grid_minutiae - Looks up the minutiae in a grid whose x and y
+#cat:                  distances to a point are both below a limit.
+
+   Input:
+      grid      - the grid to search
+      x         - x-pixel coord of the point
+      y         - y-pixel coord of the point
+      max_delta - the limit of the distances
+   Output:
+      grid->found - the nodes of the minutiae found, from the most
+                    recently added one on
+   Return Code:
+      The number of minutiae found
+**************************************************************************/
+int find_grid_minutiae(MINUTIAGRID *grid, const int x, const int y,
+                       const int max_delta)
+{
+   int cx, cy, sx, sy, ex, ey;
+   int node, nfound, i;
+   MINUTIA *minutia;
+
+   nfound = 0;
+   if(max_delta <= 0)
+      return(nfound);
+
+   sx = max(x - max_delta + 1, 0) / grid->cell_size;
+   sy = max(y - max_delta + 1, 0) / grid->cell_size;
+   ex = min(max(x + max_delta - 1, 0) / grid->cell_size, grid->gw - 1);
+   ey = min(max(y + max_delta - 1, 0) / grid->cell_size, grid->gh - 1);
+
+   for(cy = min(sy, grid->gh - 1); cy <= ey; cy++){
+      for(cx = min(sx, grid->gw - 1); cx <= ex; cx++){
+         for(node = grid->cells[(cy * grid->gw) + cx]; node >= 0;
+             node = grid->nodes[node].next){
+            minutia = grid->nodes[node].minutia;
+            if(abs(minutia->x - x) >= max_delta ||
+               abs(minutia->y - y) >= max_delta)
+               continue;
+
+            /* Keep the nodes ordered from the most recent one on. */
+            for(i = nfound; i > 0 && grid->found[i-1] < node; i--)
+               grid->found[i] = grid->found[i-1];
+            grid->found[i] = node;
+            nfound++;
+         }
+      }
+   }
+
+   return(nfound);
+}
+
 /*************************************************************************
 **************************************************************************
 #cat: join_minutia - Takes 2 minutia points and connectes their features in
@@ -1042,11 +1255,12 @@ int choose_scan_direction(const int imapval, const int ndirs)
       lfsparms  - parameters and thresholds for controlling LFS
    Output:
       minutiae   - points to a list of detected minutia structures
+      grid       - grid of the minutiae in the list
    Return Code:
       Zero      - successful completion
       Negative  - system error
 **************************************************************************/
-int scan4minutiae_horizontally_V2(MINUTIAE *minutiae,
+int scan4minutiae_horizontally_V2(MINUTIAE *minutiae, MINUTIAGRID *grid,
                 unsigned char *bdata, const int iw, const int ih,
                 int *pdirection_map, int *plow_flow_map, int *phigh_curve_map,
                 const LFSPARMS *lfsparms)
@@ -1098,7 +1312,7 @@ int scan4minutiae_horizontally_V2(MINUTIAE *minutiae,
                      if(match_3rd_pair(*p1ptr, *p2ptr, possible, &nposs)){
                         /* Process detected minutia point. */
                         if((ret = process_horizontal_scan_minutia_V2(minutiae,
-                                         cx, cy, x2, possible[0],
+                                         grid, cx, cy, x2, possible[0],
                                          bdata, iw, ih, pdirection_map,
                                          plow_flow_map, phigh_curve_map,
                                          lfsparms))){
@@ -1193,11 +1407,12 @@ int scan4minutiae_horizontally_V2(MINUTIAE *minutiae,
       lfsparms  - parameters and thresholds for controlling LFS
    Output:
       minutiae   - points to a list of detected minutia structures
+      grid       - grid of the minutiae in the list
    Return Code:
       Zero      - successful completion
       Negative  - system error
 **************************************************************************/
-int scan4minutiae_vertically_V2(MINUTIAE *minutiae,
+int scan4minutiae_vertically_V2(MINUTIAE *minutiae, MINUTIAGRID *grid,
                 unsigned char *bdata, const int iw, const int ih,
                 int *pdirection_map, int *plow_flow_map, int *phigh_curve_map,
                 const LFSPARMS *lfsparms)
@@ -1249,7 +1464,7 @@ int scan4minutiae_vertically_V2(MINUTIAE *minutiae,
                      if(match_3rd_pair(*p1ptr, *p2ptr, possible, &nposs)){
                         /* Process detected minutia point. */
                         if((ret = process_vertical_scan_minutia_V2(minutiae,
-                                         cx, cy, y2, possible[0],
+                                         grid, cx, cy, y2, possible[0],
                                          bdata, iw, ih, pdirection_map,
                                          plow_flow_map, phigh_curve_map,
                                          lfsparms))){
@@ -1532,12 +1747,13 @@ int scan4minutiae_vertically_V2(MINUTIAE *minutiae,
       lfsparms  - parameters and thresholds for controlling LFS
    Output:
       minutiae   - points to a list of detected minutia structures
+      grid       - grid of the minutiae in the list
    Return Code:
       Zero      - successful completion
       IGNORE    - minutia is to be ignored
       Negative  - system error
 **************************************************************************/
-int process_horizontal_scan_minutia_V2(MINUTIAE *minutiae,
+int process_horizontal_scan_minutia_V2(MINUTIAE *minutiae, MINUTIAGRID *grid,
                  const int cx, const int cy,
                  const int x2, const int feature_id,
                  unsigned char *bdata, const int iw, const int ih,
@@ -1621,7 +1837,7 @@ int process_horizontal_scan_minutia_V2(MINUTIAE *minutiae,
       return(ret);
 
    /* Update the minutiae list with potential new minutia. */
-   ret = update_minutiae_V2(minutiae, minutia, SCAN_HORIZONTAL,
+   ret = update_minutiae_V2(minutiae, grid, minutia, SCAN_HORIZONTAL,
                             dmapval, bdata, iw, ih, lfsparms);
 
    /* If minuitia IGNORED and not added to the minutia list ... */
@@ -1684,12 +1900,13 @@ int process_horizontal_scan_minutia_V2(MINUTIAE *minutiae,
       lfsparms  - parameters and thresholds for controlling LFS
    Output:
       minutiae   - points to a list of detected minutia structures
+      grid       - grid of the minutiae in the list
    Return Code:
       Zero      - successful completion
       IGNORE    - minutia is to be ignored
       Negative  - system error
 **************************************************************************/
-int process_vertical_scan_minutia_V2(MINUTIAE *minutiae,
+int process_vertical_scan_minutia_V2(MINUTIAE *minutiae, MINUTIAGRID *grid,
                  const int cx, const int cy,
                  const int y2, const int feature_id,
                  unsigned char *bdata, const int iw, const int ih,
@@ -1772,7 +1989,7 @@ int process_vertical_scan_minutia_V2(MINUTIAE *minutiae,
       return(ret);
 
    /* Update the minutiae list with potential new minutia. */
-   ret = update_minutiae_V2(minutiae, minutia, SCAN_VERTICAL,
+   ret = update_minutiae_V2(minutiae, grid, minutia, SCAN_VERTICAL,
                             dmapval, bdata, iw, ih, lfsparms);
 
    /* If minuitia IGNORED and not added to the minutia list ... */
@@ -131,69 +131,90 @@ int remove_false_minutia_V2(MINUTIAE *minutiae,
            const int mw, const int mh, const LFSPARMS *lfsparms)
 {
    int ret;
+   gint64 start;
 
    /* 1. Sort minutiae points top-to-bottom and left-to-right. */
+   start = lfs_stage_start();
    if((ret = sort_minutiae_y_x(minutiae, iw, ih))){
       return(ret);
    }
+   lfs_stage_done(LFS_STAGE_SORT, start);
 
    /* 2. Remove minutiae on lakes (filled with white pixels) and        */
    /*    islands (filled with black pixels), both  defined by a pair of */
    /*    minutia points.                                                */
+   start = lfs_stage_start();
    if((ret = remove_islands_and_lakes(minutiae, bdata, iw, ih, lfsparms))){
       return(ret);
    }
+   lfs_stage_done(LFS_STAGE_ISLANDS_AND_LAKES, start);
 
    /* 3. Remove minutiae on holes in the binary image defined by a */
    /*    single point.                                             */
+   start = lfs_stage_start();
    if((ret = remove_holes(minutiae, bdata, iw, ih, lfsparms))){
       return(ret);
    }
+   lfs_stage_done(LFS_STAGE_HOLES, start);
 
    /* 4. Remove minutiae that point sufficiently close to a block with */
    /*    INVALID direction.                                            */
+   start = lfs_stage_start();
    if((ret = remove_pointing_invblock_V2(minutiae, direction_map, mw, mh,
                                         lfsparms))){
       return(ret);
    }
+   lfs_stage_done(LFS_STAGE_POINTING_INVBLOCK, start);
 
    /* 5. Remove minutiae that are sufficiently close to a block with */
    /*    INVALID direction.                                          */
+   start = lfs_stage_start();
    if((ret = remove_near_invblock_V2(minutiae, direction_map, mw, mh,
                                     lfsparms))){
       return(ret);
    }
+   lfs_stage_done(LFS_STAGE_NEAR_INVBLOCK, start);
 
    /* 6. Remove or adjust minutiae that reside on the side of a ridge */
    /*    or valley.                                                   */
+   start = lfs_stage_start();
    if((ret = remove_or_adjust_side_minutiae_V2(minutiae, bdata, iw, ih,
                                   direction_map, mw, mh, lfsparms))){
       return(ret);
    }
+   lfs_stage_done(LFS_STAGE_SIDE_MINUTIAE, start);
 
    /* 7. Remove minutiae that form a hook on the side of a ridge or valley. */
+   start = lfs_stage_start();
    if((ret = remove_hooks(minutiae, bdata, iw, ih, lfsparms))){
       return(ret);
    }
+   lfs_stage_done(LFS_STAGE_HOOKS, start);
 
    /* 8. Remove minutiae that are on opposite sides of an overlap. */
+   start = lfs_stage_start();
    if((ret = remove_overlaps(minutiae, bdata, iw, ih, lfsparms))){
       return(ret);
    }
+   lfs_stage_done(LFS_STAGE_OVERLAPS, start);
 
    /* 9. Remove minutiae that are "irregularly" shaped. */
+   start = lfs_stage_start();
    if((ret = remove_malformations(minutiae, bdata, iw, ih,
                                  low_flow_map, mw, mh, lfsparms))){
       return(ret);
    }
+   lfs_stage_done(LFS_STAGE_MALFORMATIONS, start);
 
    /* 10. Remove minutiae that form long, narrow, loops in the */
    /*     "unreliable" regions in the binary image.            */
+   start = lfs_stage_start();
    if((ret = remove_pores_V2(minutiae,  bdata, iw, ih,
                             direction_map, low_flow_map, high_curve_map,
                             mw, mh, lfsparms))){
       return(ret);
    }
+   lfs_stage_done(LFS_STAGE_PORES, start);
 
    return(0);
 }
@@ -950,8 +971,8 @@ int remove_malformations(MINUTIAE *minutiae,
                         print2log("%d,%d RMMAL3 (%f)\n",
                                   minutia->x, minutia->y, ratio);
                         if((ret = remove_minutia(i, minutiae))){
-                           g_free(x_list);
-                           g_free(y_list);
+                           lfs_free(x_list);
+                           lfs_free(y_list);
                            /* If system error, return error code. */
                            return(ret);
                         }
@@ -961,8 +982,8 @@ int remove_malformations(MINUTIAE *minutiae,
                   }
                }
 
-               g_free(x_list);
-               g_free(y_list);
+               lfs_free(x_list);
+               lfs_free(y_list);
 
             }
          }
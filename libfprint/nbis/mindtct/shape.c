@@ -98,11 +98,11 @@ int alloc_shape(SHAPE **oshape, const int xmin, const int ymin,
    alloc_pts = xmax - xmin + 1;
 
    /* Allocate the shape structure. */
-   shape = (SHAPE *)g_malloc(sizeof(SHAPE));
+   shape = (SHAPE *)lfs_malloc(sizeof(SHAPE));
 
    /* Allocate the list of row pointers.  We now this number will fit */
    /* the shape exactly.                                              */
-   shape->rows = (ROW **)g_malloc(alloc_rows * sizeof(ROW *));
+   shape->rows = (ROW **)lfs_malloc(alloc_rows * sizeof(ROW *));
 
    /* Initialize the shape structure's attributes. */
    shape->ymin = ymin;
@@ -116,10 +116,10 @@ int alloc_shape(SHAPE **oshape, const int xmin, const int ymin,
    for(i = 0, y = ymin; i < alloc_rows; i++, y++){
       /* Allocate a row structure and store it in its respective position */
       /* in the shape structure's list of row pointers.                   */
-      shape->rows[i] = (ROW *)g_malloc(sizeof(ROW));
+      shape->rows[i] = (ROW *)lfs_malloc(sizeof(ROW));
 
       /* Allocate the current rows list of x-coords. */
-      shape->rows[i]->xs = (int *)g_malloc(alloc_pts * sizeof(int));
+      shape->rows[i]->xs = (int *)lfs_malloc(alloc_pts * sizeof(int));
 
       /* Initialize the current row structure's attributes. */
       shape->rows[i]->y = y;
@@ -150,15 +150,15 @@ void free_shape(SHAPE *shape)
    /* Foreach allocated row in the shape ... */
    for(i = 0; i < shape->alloc; i++){
       /* Deallocate the current row's list of x-coords. */
-      g_free(shape->rows[i]->xs);
+      lfs_free(shape->rows[i]->xs);
       /* Deallocate the current row structure. */
-      g_free(shape->rows[i]);
+      lfs_free(shape->rows[i]);
    }
 
    /* Deallocate the list of row pointers. */
-   g_free(shape->rows);
+   lfs_free(shape->rows);
    /* Deallocate the shape structure. */
-   g_free(shape);
+   lfs_free(shape);
 }
 
 /*************************************************************************
@@ -222,7 +222,7 @@ int shape_from_contour(SHAPE **oshape, const int *contour_x,
          if(row->npts >= row->alloc){
             /* This should never happen becuase we have allocated */
             /* based on shape bounding limits.                    */
-            g_free(shape);
+            lfs_free(shape);
             fprintf(stderr,
                     "ERROR : shape_from_contour : row overflow\n");
             return(-260);
@@ -65,9 +65,20 @@ of the software.
                         angle2line()
                         line2direction()
                         closest_dir_dist()
+                        run_lfs_workers()
+                        new_lfs_arena()
+                        free_lfs_arena()
+                        set_lfs_arena()
+                        lfs_malloc()
+                        lfs_realloc()
+                        lfs_free()
+                        set_lfs_timings()
+                        lfs_stage_start()
+                        lfs_stage_done()
 ***********************************************************************/
 
 #include <stdio.h>
+#include <string.h>
 #include <lfs.h>
 
 /*************************************************************************
@@ -587,3 +598,349 @@ int closest_dir_dist(const int dir1, const int dir2, const int ndirs)
    return(dist);
 }
 
+/*************************************************************************
+**************************************************************************
+#cat: run_lfs_workers - Runs a worker routine on several threads at once
+#cat:           and waits for all of them to return.  The calling thread
+#cat:           is one of the workers, the others come from a thread pool
+#cat:           that is shared by all parallel stages of the detection.
+#cat:           The workers are expected to claim their share of the job
+#cat:           from data themselves.
+
+   Input:
+      worker   - the routine to run
+      data     - the job, which is passed to every worker
+      nworkers - the number of workers, including the calling thread
+**************************************************************************/
+typedef struct lfsworkers{
+   void (*worker)(void *);
+   void *data;
+
+   GMutex lock;
+   GCond done;
+   int running;
+} LFSWORKERS;
+
+static void lfs_worker_done(LFSWORKERS *workers)
+{
+   g_mutex_lock(&workers->lock);
+   if(--workers->running == 0)
+      g_cond_signal(&workers->done);
+   g_mutex_unlock(&workers->lock);
+}
+
+static void lfs_pool_worker(gpointer data, gpointer user_data)
+{
+   LFSWORKERS *workers = (LFSWORKERS *)data;
+
+   workers->worker(workers->data);
+   lfs_worker_done(workers);
+}
+
+static GThreadPool *get_lfs_pool(void)
+{
+   static gsize pool_initialized = 0;
+   static GThreadPool *pool = NULL;
+
+   if(g_once_init_enter(&pool_initialized)){
+      pool = g_thread_pool_new(lfs_pool_worker, NULL,
+                               g_get_num_processors(), FALSE, NULL);
+      g_once_init_leave(&pool_initialized, 1);
+   }
+
+   return(pool);
+}
+
+void run_lfs_workers(void (*worker)(void *), void *data, const int nworkers)
+{
+   LFSWORKERS workers;
+   int i;
+
+   if(nworkers <= 1){
+      worker(data);
+      return;
+   }
+
+   workers.worker = worker;
+   workers.data = data;
+   workers.running = nworkers;
+   g_mutex_init(&workers.lock);
+   g_cond_init(&workers.done);
+
+   for(i = 1; i < nworkers; i++)
+      g_thread_pool_push(get_lfs_pool(), &workers, NULL);
+   worker(data);
+   lfs_worker_done(&workers);
+
+   g_mutex_lock(&workers.lock);
+   while(workers.running > 0)
+      g_cond_wait(&workers.done, &workers.lock);
+   g_mutex_unlock(&workers.lock);
+
+   g_mutex_clear(&workers.lock);
+   g_cond_clear(&workers.done);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: new_lfs_arena - Allocates an empty memory arena.  While an arena is
+#cat:           set for a thread with set_lfs_arena(), lfs_malloc() and
+#cat:           friends allocate from it instead of the heap.  This is
+#cat:           used for the many small, short lived allocations of a
+#cat:           single minutiae detection, which are all released at once
+#cat:           with free_lfs_arena() afterwards.  Memory that is freed in
+#cat:           the reverse order of its allocation is reused right away.
+
+   Return Code:
+      The new arena
+**************************************************************************/
+#define LFS_ARENA_CHUNK_SIZE (256 * 1024)
+#define LFS_ARENA_ALIGN(size) (((size) + 15) & ~((size_t)15))
+
+typedef struct lfsarenachunk{
+   struct lfsarenachunk *prev;
+   size_t size;
+   size_t used;
+} LFSARENACHUNK;
+
+typedef struct lfsarenablock{
+   struct lfsarenablock *prev;
+   size_t size;
+   int freed;
+} LFSARENABLOCK;
+
+struct lfsarena{
+   LFSARENACHUNK *chunk;
+   LFSARENABLOCK *top;
+};
+
+#define LFS_ARENA_CHUNK_HDR LFS_ARENA_ALIGN(sizeof(LFSARENACHUNK))
+#define LFS_ARENA_BLOCK_HDR LFS_ARENA_ALIGN(sizeof(LFSARENABLOCK))
+#define LFS_ARENA_CHUNK_DATA(chunk) ((char *)(chunk) + LFS_ARENA_CHUNK_HDR)
+
+static GPrivate lfs_arena_key = G_PRIVATE_INIT(NULL);
+
+LFSARENA *new_lfs_arena(void)
+{
+   return((LFSARENA *)g_malloc0(sizeof(LFSARENA)));
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: free_lfs_arena - Releases an arena and all memory allocated from it.
+
+   Input:
+      arena - the arena, which must not be set for any thread anymore
+**************************************************************************/
+void free_lfs_arena(LFSARENA *arena)
+{
+   LFSARENACHUNK *chunk;
+
+   while((chunk = arena->chunk) != (LFSARENACHUNK *)NULL){
+      arena->chunk = chunk->prev;
+      g_free(chunk);
+   }
+   g_free(arena);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: set_lfs_arena - Sets the arena that lfs_malloc() allocates from on
+#cat:           the calling thread.
+
+   Input:
+      arena - the arena to use, or NULL to allocate from the heap again
+   Return Code:
+      The arena that was set before
+**************************************************************************/
+LFSARENA *set_lfs_arena(LFSARENA *arena)
+{
+   LFSARENA *prev_arena;
+
+   prev_arena = (LFSARENA *)g_private_get(&lfs_arena_key);
+   g_private_set(&lfs_arena_key, arena);
+
+   return(prev_arena);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_malloc - Allocates memory from the arena of the calling thread,
+#cat:           or from the heap if it has none.  The memory must be
+#cat:           released with lfs_free() while the same arena is set.
+
+   Input:
+      size - number of bytes to allocate
+   Return Code:
+      The allocated memory
+**************************************************************************/
+void *lfs_malloc(const size_t size)
+{
+   LFSARENA *arena;
+   LFSARENACHUNK *chunk;
+   LFSARENABLOCK *block;
+   size_t need, chunk_size;
+
+   arena = (LFSARENA *)g_private_get(&lfs_arena_key);
+   if(arena == (LFSARENA *)NULL)
+      return(g_malloc(size));
+
+   need = LFS_ARENA_BLOCK_HDR + LFS_ARENA_ALIGN(size);
+   chunk = arena->chunk;
+   if(chunk == (LFSARENACHUNK *)NULL || chunk->used + need > chunk->size){
+      chunk_size = max(LFS_ARENA_CHUNK_SIZE, need);
+      chunk = (LFSARENACHUNK *)g_malloc(LFS_ARENA_CHUNK_HDR + chunk_size);
+      chunk->prev = arena->chunk;
+      chunk->size = chunk_size;
+      chunk->used = 0;
+      arena->chunk = chunk;
+   }
+
+   block = (LFSARENABLOCK *)(LFS_ARENA_CHUNK_DATA(chunk) + chunk->used);
+   chunk->used += need;
+   block->prev = arena->top;
+   block->size = size;
+   block->freed = FALSE;
+   arena->top = block;
+
+   return((char *)block + LFS_ARENA_BLOCK_HDR);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_realloc - Resizes memory allocated with lfs_malloc().  The most
+#cat:           recent allocation of an arena grows in place if possible.
+
+   Input:
+      ptr  - the memory to resize, or NULL
+      size - the new size in bytes
+   Return Code:
+      The resized memory
+**************************************************************************/
+void *lfs_realloc(void *ptr, const size_t size)
+{
+   LFSARENA *arena;
+   LFSARENACHUNK *chunk;
+   LFSARENABLOCK *block;
+   size_t offset;
+   void *new_ptr;
+
+   arena = (LFSARENA *)g_private_get(&lfs_arena_key);
+   if(arena == (LFSARENA *)NULL)
+      return(g_realloc(ptr, size));
+   if(ptr == NULL)
+      return(lfs_malloc(size));
+
+   block = (LFSARENABLOCK *)((char *)ptr - LFS_ARENA_BLOCK_HDR);
+   chunk = arena->chunk;
+   if(block == arena->top && (char *)block >= LFS_ARENA_CHUNK_DATA(chunk) &&
+      (char *)block < LFS_ARENA_CHUNK_DATA(chunk) + chunk->size){
+      offset = (char *)block - LFS_ARENA_CHUNK_DATA(chunk);
+      if(offset + LFS_ARENA_BLOCK_HDR + LFS_ARENA_ALIGN(size) <= chunk->size){
+         chunk->used = offset + LFS_ARENA_BLOCK_HDR + LFS_ARENA_ALIGN(size);
+         block->size = size;
+         return(ptr);
+      }
+   }
+
+   new_ptr = lfs_malloc(size);
+   memcpy(new_ptr, ptr, min(block->size, size));
+   lfs_free(ptr);
+
+   return(new_ptr);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_free - Releases memory allocated with lfs_malloc().
+
+   Input:
+      ptr - the memory to release, or NULL
+**************************************************************************/
+void lfs_free(void *ptr)
+{
+   LFSARENA *arena;
+   LFSARENACHUNK *chunk;
+   LFSARENABLOCK *block;
+
+   if(ptr == NULL)
+      return;
+
+   arena = (LFSARENA *)g_private_get(&lfs_arena_key);
+   if(arena == (LFSARENA *)NULL){
+      g_free(ptr);
+      return;
+   }
+
+   block = (LFSARENABLOCK *)((char *)ptr - LFS_ARENA_BLOCK_HDR);
+   block->freed = TRUE;
+
+   /* Give the space of the freed blocks at the top back to the chunk */
+   /* they are in.  Blocks in older chunks stay allocated until the   */
+   /* arena is released.                                              */
+   chunk = arena->chunk;
+   while(arena->top != (LFSARENABLOCK *)NULL && arena->top->freed){
+      block = arena->top;
+      arena->top = block->prev;
+      if((char *)block >= LFS_ARENA_CHUNK_DATA(chunk) &&
+         (char *)block < LFS_ARENA_CHUNK_DATA(chunk) + chunk->size)
+         chunk->used = (char *)block - LFS_ARENA_CHUNK_DATA(chunk);
+   }
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: set_lfs_timings - Sets where the time spent in the stages of the
+#cat:           minutiae detections on the calling thread is recorded.
+#cat:           The times are added to the ones already in the structure.
+
+   Input:
+      timings - the structure to record into, or NULL to stop recording
+   Return Code:
+      The structure that was set before
+**************************************************************************/
+static GPrivate lfs_timings_key = G_PRIVATE_INIT(NULL);
+
+LFSTIMINGS *set_lfs_timings(LFSTIMINGS *timings)
+{
+   LFSTIMINGS *prev_timings;
+
+   prev_timings = (LFSTIMINGS *)g_private_get(&lfs_timings_key);
+   g_private_set(&lfs_timings_key, timings);
+
+   return(prev_timings);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_stage_start - Returns the start time of a detection stage, to be
+#cat:           passed to lfs_stage_done() once the stage is finished.
+
+   Return Code:
+      The current monotonic time (in microseconds)
+**************************************************************************/
+gint64 lfs_stage_start(void)
+{
+   return(g_get_monotonic_time());
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: lfs_stage_done - Records the time spent in a detection stage, if the
+#cat:           calling thread has set timings to record into.
+
+   Input:
+      stage - the finished stage {LFS_STAGE_*}
+      start - the time returned by lfs_stage_start()
+**************************************************************************/
+void lfs_stage_done(const int stage, const gint64 start)
+{
+   LFSTIMINGS *timings;
+
+   timings = (LFSTIMINGS *)g_private_get(&lfs_timings_key);
+   if(timings == (LFSTIMINGS *)NULL)
+      return;
+
+   timings->stages[stage] += (g_get_monotonic_time() - start) /
+                             (double)G_USEC_PER_SEC;
+}
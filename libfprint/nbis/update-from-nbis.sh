@@ -192,3 +192,47 @@ spatch --sp-file remove-global-y.cocci bozorth3/* include/bozorth.h --in-place
 # The above leaves an unused variable around, triggering a warning
 # remove it.
 patch -p0 < glib-mem-warning.patch
+
+# Move the bozorth3 global tables into a per-match context so that several
+# matches can run in parallel
+patch -p0 < bozorth3-match-context.patch
+
+# Allow building the gallery web once and reusing it for every match
+patch -p0 < bozorth3-gallery-web.patch
+
+# Vectorize the pair distances of bz_comp() and sort its table only once
+patch -p0 < bozorth3-simd-comp.patch
+
+# Allow stopping the scoring once a match threshold is known to be reached
+# or known to be out of reach
+patch -p0 < bozorth3-threshold-score.patch
+
+# Build the mindtct lookup tables once per image width instead of for
+# every detection
+patch -p0 < mindtct-setup-cache.patch
+
+# Compute the blocks of the initial maps on a pool of worker threads
+patch -p0 < mindtct-parallel-maps.patch
+
+# Vectorize the row sums and wave powers of the DFT direction analysis
+patch -p0 < mindtct-simd-dft.patch
+
+# Add a fixed point variant of the DFT powers, and avoid floating point
+# math for every pixel in the directional binarization
+patch -p0 < mindtct-fixed-point.patch
+
+# Binarize stripes of image rows on the worker threads of the initial maps,
+# sharing one pool and one wait helper between both stages
+patch -p0 < mindtct-parallel-binarize.patch
+
+# Allocate the temporary data of a detection from a per-call arena
+patch -p0 < mindtct-arena.patch
+
+# Record the time spent in the stages of a detection
+patch -p0 < mindtct-stage-timings.patch
+
+# Allow skipping the neighbor and ridge count search for XYT templates
+patch -p0 < mindtct-xyt-profile.patch
+
+# Look up the minutiae close to new candidates through a grid
+patch -p0 < mindtct-minutia-grid.patch
@@ -0,0 +1,359 @@
+/*
+ * Check the optimized bozorth3 pairwise comparison table
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+#include <nbis.h>
+
+#include "test-utils.h"
+
+typedef struct
+{
+  int ncomparisons;
+  int cols[FCOLS_SIZE_1][COLS_SIZE_2];
+  int *colptrs[FCOLPT_SIZE];
+} CompTable;
+
+/* The original NBIS bz_comp(), which inserts each row into the sorted
+ * pointer list as it is computed. */
+static void
+bz_comp_reference (int npoints, int xcol[], int ycol[], int thetacol[],
+                   int *ncomparisons, int cols[][COLS_SIZE_2], int *colptrs[])
+{
+  int table_index = 0;
+  int i, j, k;
+
+  for (k = 0; k < npoints - 1; k++)
+    {
+      for (j = k + 1; j < npoints; j++)
+        {
+          int dx, dy, distance;
+          int theta_kj, beta_j, beta_k;
+          int b, t, l, n;
+          int *c;
+
+          if (thetacol[j] > 0)
+            {
+              if (thetacol[k] == thetacol[j] - 180)
+                continue;
+            }
+          else
+            {
+              if (thetacol[k] == thetacol[j] + 180)
+                continue;
+            }
+
+          dx = xcol[j] - xcol[k];
+          dy = ycol[j] - ycol[k];
+          distance = SQUARED (dx) + SQUARED (dy);
+          if (distance > SQUARED (DM))
+            {
+              if (dx > DM)
+                break;
+              else
+                continue;
+            }
+
+          if (dx == 0)
+            {
+              theta_kj = 90;
+            }
+          else
+            {
+              double dz;
+
+              dz = (180.0F / PI_SINGLE) * atanf ((float) dy / (float) dx);
+              if (dz < 0.0F)
+                dz -= 0.5F;
+              else
+                dz += 0.5F;
+              theta_kj = (int) dz;
+            }
+
+          beta_k = theta_kj - thetacol[k];
+          beta_k = IANGLE180 (beta_k);
+
+          beta_j = theta_kj - thetacol[j] + 180;
+          beta_j = IANGLE180 (beta_j);
+
+          c = cols[table_index];
+          c[0] = distance;
+          c[3] = k + 1;
+          c[4] = j + 1;
+          if (beta_k < beta_j)
+            {
+              c[1] = beta_k;
+              c[2] = beta_j;
+              c[5] = theta_kj;
+            }
+          else
+            {
+              c[1] = beta_j;
+              c[2] = beta_k;
+              c[5] = theta_kj + 400;
+            }
+
+          /* Binary search for the insertion point of the new row */
+          b = 0;
+          t = table_index + 1;
+          l = 1;
+          n = -1;
+          while (t - b > 1)
+            {
+              int *midpoint;
+
+              l = (b + t) / 2;
+              midpoint = colptrs[l - 1];
+
+              for (i = 0; i < 3; i++)
+                {
+                  n = SENSE (cols[table_index][i], midpoint[i]);
+                  if (n < 0)
+                    {
+                      t = l;
+                      break;
+                    }
+                  if (n > 0)
+                    {
+                      b = l;
+                      break;
+                    }
+                }
+
+              if (n == 0)
+                {
+                  n = 1;
+                  b = l;
+                }
+            }
+
+          if (n == 1)
+            ++l;
+
+          for (i = table_index; i >= l; --i)
+            colptrs[i] = colptrs[i - 1];
+
+          colptrs[l - 1] = &cols[table_index][0];
+          ++table_index;
+
+          if (table_index == 19999)
+            goto out;
+        }
+    }
+
+out:
+  *ncomparisons = table_index;
+}
+
+/* Minutiae are sorted by x and then y, like libfprint stores them */
+static gint
+compare_minutiae (gconstpointer a, gconstpointer b)
+{
+  const int *ma = a;
+  const int *mb = b;
+
+  if (ma[0] != mb[0])
+    return ma[0] - mb[0];
+  return ma[1] - mb[1];
+}
+
+static void
+generate_xyt (GRand *rand, struct xyt_struct *xyt, int nrows, int width, int height)
+{
+  int minutiae[MAX_BOZORTH_MINUTIAE][3];
+  int i;
+
+  for (i = 0; i < nrows; i++)
+    {
+      minutiae[i][0] = g_rand_int_range (rand, 0, width);
+      minutiae[i][1] = g_rand_int_range (rand, 0, height);
+      minutiae[i][2] = g_rand_int_range (rand, -179, 181);
+
+      /* Provoke the special cases: vertical pairs, duplicate points and
+       * minutiae pointing in opposite directions. */
+      if (i > 0 && g_rand_int_range (rand, 0, 8) == 0)
+        minutiae[i][0] = minutiae[i - 1][0];
+      if (i > 0 && g_rand_int_range (rand, 0, 16) == 0)
+        minutiae[i][1] = minutiae[i - 1][1];
+      if (i > 0 && g_rand_int_range (rand, 0, 16) == 0)
+        minutiae[i][2] = minutiae[i - 1][2] > 0 ? minutiae[i - 1][2] - 180 : minutiae[i - 1][2] + 180;
+    }
+
+  qsort (minutiae, nrows, sizeof (minutiae[0]), compare_minutiae);
+
+  for (i = 0; i < nrows; i++)
+    {
+      xyt->xcol[i] = minutiae[i][0];
+      xyt->ycol[i] = minutiae[i][1];
+      xyt->thetacol[i] = minutiae[i][2];
+    }
+  xyt->nrows = nrows;
+}
+
+static void
+assert_tables_equal (struct xyt_struct *xyt, CompTable *expected, CompTable *actual)
+{
+  int simd, i;
+
+  bz_comp_reference (xyt->nrows, xyt->xcol, xyt->ycol, xyt->thetacol,
+                     &expected->ncomparisons, expected->cols, expected->colptrs);
+
+  /* Every instruction set this processor supports, down to the scalar code */
+  for (simd = 0; simd <= bz_comp_simd_level (); simd++)
+    {
+      bz_comp (xyt->nrows, xyt->xcol, xyt->ycol, xyt->thetacol,
+               &actual->ncomparisons, actual->cols, actual->colptrs, simd);
+
+      g_assert_cmpint (actual->ncomparisons, ==, expected->ncomparisons);
+
+      /* The rows need to be identical and in the same order */
+      for (i = 0; i < expected->ncomparisons; i++)
+        {
+          g_assert_cmpmem (actual->colptrs[i], sizeof (int) * COLS_SIZE_2,
+                           expected->colptrs[i], sizeof (int) * COLS_SIZE_2);
+          g_assert_cmpint (actual->colptrs[i] - &actual->cols[0][0], ==,
+                           expected->colptrs[i] - &expected->cols[0][0]);
+        }
+    }
+}
+
+static void
+test_bz_comp_random (void)
+{
+  g_autoptr(GRand) rand = g_rand_new_with_seed (0x62337a33);
+  g_autofree CompTable *expected = g_new0 (CompTable, 1);
+  g_autofree CompTable *actual = g_new0 (CompTable, 1);
+  struct xyt_struct xyt;
+  int i;
+
+  for (i = 0; i < 200; i++)
+    {
+      int nrows = g_rand_int_range (rand, 0, MAX_BOZORTH_MINUTIAE + 1);
+
+      /* Sensor sized images, where most pairs are close enough for
+       * the table, and large ones where many are skipped. */
+      if (i % 2)
+        generate_xyt (rand, &xyt, nrows, 256, 360);
+      else
+        generate_xyt (rand, &xyt, nrows, 1000, 1000);
+
+      assert_tables_equal (&xyt, expected, actual);
+    }
+}
+
+static void
+test_bz_comp_large_coordinates (void)
+{
+  g_autoptr(GRand) rand = g_rand_new_with_seed (0x6c617267);
+  g_autofree CompTable *expected = g_new0 (CompTable, 1);
+  g_autofree CompTable *actual = g_new0 (CompTable, 1);
+  struct xyt_struct xyt;
+  int i;
+
+  /* Coordinates that do not fit the vectorized distance computation */
+  generate_xyt (rand, &xyt, 100, 200, 200);
+  for (i = 0; i < xyt.nrows; i++)
+    xyt.ycol[i] += 40000;
+
+  assert_tables_equal (&xyt, expected, actual);
+}
+
+/* Minutiae as found by mindtct, in the xyt format of minutiae_to_xyt() */
+static void
+scan_xyt (const gchar *name, struct xyt_struct *xyt)
+{
+  g_autofree guchar *image = NULL;
+  int minutiae[MAX_BOZORTH_MINUTIAE][3];
+  MINUTIAE *detected;
+  int *quality_map, *direction_map, *low_contrast_map;
+  int *low_flow_map, *high_curve_map;
+  int map_w, map_h;
+  unsigned char *bdata;
+  int bw, bh, bd;
+  gint width, height;
+  int i, nrows;
+
+  image = fpt_load_example_print (name, &width, &height);
+
+  g_assert_cmpint (get_minutiae (&detected, &quality_map, &direction_map,
+                                 &low_contrast_map, &low_flow_map, &high_curve_map,
+                                 &map_w, &map_h, &bdata, &bw, &bh, &bd,
+                                 image, width, height, 8, DEFAULT_PPI / 25.4,
+                                 &g_lfsparms_V2), ==, 0);
+
+  nrows = MIN (detected->num, MAX_BOZORTH_MINUTIAE);
+  for (i = 0; i < nrows; i++)
+    {
+      lfs2nist_minutia_XYT (&minutiae[i][0], &minutiae[i][1], &minutiae[i][2],
+                            detected->list[i], width, height);
+      if (minutiae[i][2] > 180)
+        minutiae[i][2] -= 360;
+    }
+
+  qsort (minutiae, nrows, sizeof (minutiae[0]), compare_minutiae);
+
+  for (i = 0; i < nrows; i++)
+    {
+      xyt->xcol[i] = minutiae[i][0];
+      xyt->ycol[i] = minutiae[i][1];
+      xyt->thetacol[i] = minutiae[i][2];
+    }
+  xyt->nrows = nrows;
+
+  free_minutiae (detected);
+  g_free (quality_map);
+  g_free (direction_map);
+  g_free (low_contrast_map);
+  g_free (low_flow_map);
+  g_free (high_curve_map);
+  g_free (bdata);
+}
+
+static void
+test_bz_comp_example_print (gconstpointer user_data)
+{
+  const gchar *name = user_data;
+  g_autofree CompTable *expected = g_new0 (CompTable, 1);
+  g_autofree CompTable *actual = g_new0 (CompTable, 1);
+  struct xyt_struct xyt;
+
+  scan_xyt (name, &xyt);
+  g_assert_cmpint (xyt.nrows, >, 0);
+
+  assert_tables_equal (&xyt, expected, actual);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/bozorth3/bz_comp/random", test_bz_comp_random);
+  g_test_add_func ("/bozorth3/bz_comp/large-coordinates", test_bz_comp_large_coordinates);
+  g_test_add_data_func ("/bozorth3/bz_comp/arch",
+                        "arch.png", test_bz_comp_example_print);
+  g_test_add_data_func ("/bozorth3/bz_comp/loop-right",
+                        "loop-right.png", test_bz_comp_example_print);
+  g_test_add_data_func ("/bozorth3/bz_comp/tented-arch",
+                        "tented_arch.png", test_bz_comp_example_print);
+  g_test_add_data_func ("/bozorth3/bz_comp/whorl",
+                        "whorl.png", test_bz_comp_example_print);
+
+  return g_test_run ();
+}
@@ -0,0 +1,405 @@
+/*
+ * Check the frame assembling routines used by swipe sensor drivers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "fpi-image.h"
+#include "fpi-assembling.h"
+#include "test-utils.h"
+
+/* Percentage of the frame movements that need to be found, the overlap
+ * of the 8 lines high frames of the aes1610 is often ambiguous. */
+#define MIN_MOVEMENTS_FOUND 85
+
+typedef struct
+{
+  unsigned int frame_width;
+  unsigned int frame_height;
+  unsigned int bits_per_pixel;
+  unsigned int stride;
+  gboolean     column_major;
+} FrameLayout;
+
+typedef struct
+{
+  const gchar       *name;
+  const gchar       *print;
+  const FrameLayout *layout;
+} SwipeData;
+
+typedef struct
+{
+  struct fpi_frame_asmbl_ctx ctx;
+  const FrameLayout         *layout;
+} TestAsmblCtx;
+
+static unsigned char
+layout_get_pixel (struct fpi_frame_asmbl_ctx *ctx,
+                  struct fpi_frame           *frame,
+                  unsigned int                x,
+                  unsigned int                y)
+{
+  const FrameLayout *layout = ((TestAsmblCtx *) ctx)->layout;
+  unsigned int line = layout->column_major ? x : y;
+  unsigned int i = layout->column_major ? y : x;
+  unsigned char v;
+
+  if (layout->bits_per_pixel == 8)
+    return frame->data[line * layout->stride + i];
+
+  v = frame->data[line * layout->stride + i / 2];
+  v = i % 2 ? v >> 4 : v & 0xf;
+
+  return v * 17;
+}
+
+/* Cuts a print into frames, like a finger moving over the sensor at a
+ * varying speed. The movement to the next frame is stored in the deltas
+ * of each frame. */
+static GSList *
+swipe_print (GRand *rand, const gchar *name, const FrameLayout *layout)
+{
+  g_autofree guint8 *print = NULL;
+  GSList *frames = NULL;
+  gint width, height;
+  int fx, fy = 0;
+  int speed = 3;
+
+  print = fpt_load_example_print (name, &width, &height);
+  fx = (width - layout->frame_width) / 2;
+
+  while (fy + layout->frame_height <= height)
+    {
+      struct fpi_frame *frame;
+      unsigned int lines, x, y;
+
+      lines = layout->column_major ? layout->frame_width : layout->frame_height;
+      frame = g_malloc0 (sizeof (struct fpi_frame) + lines * layout->stride);
+
+      for (y = 0; y < layout->frame_height; y++)
+        {
+          for (x = 0; x < layout->frame_width; x++)
+            {
+              /* Like any sensor, add some noise; a perfect match is
+               * taken as a sign of an empty frame. */
+              int v = print[(fy + y) * width + fx + x] + g_rand_int_range (rand, -8, 9);
+              unsigned int line = layout->column_major ? x : y;
+              unsigned int i = layout->column_major ? y : x;
+
+              v = CLAMP (v, 0, 255);
+              if (layout->bits_per_pixel == 8)
+                frame->data[line * layout->stride + i] = v;
+              else
+                frame->data[line * layout->stride + i / 2] |= (v / 17) << (i % 2 ? 4 : 0);
+            }
+        }
+
+      frames = g_slist_prepend (frames, frame);
+
+      speed = CLAMP (speed + g_rand_int_range (rand, -1, 2), 2, (int) layout->frame_height / 2);
+      frame->delta_x = CLAMP (fx + g_rand_int_range (rand, -1, 2), 0, width - (int) layout->frame_width) - fx;
+      frame->delta_y = speed;
+      fx += frame->delta_x;
+      fy += frame->delta_y;
+    }
+
+  return g_slist_reverse (frames);
+}
+
+static void
+test_ctx_init (TestAsmblCtx *test_ctx, const FrameLayout *layout)
+{
+  test_ctx->ctx = (struct fpi_frame_asmbl_ctx) {
+    .frame_width = layout->frame_width,
+    .frame_height = layout->frame_height,
+    .image_width = layout->frame_width * 3 / 2,
+    .get_pixel = layout_get_pixel,
+    .bits_per_pixel = layout->bits_per_pixel,
+    .stride = layout->stride,
+    .column_major = layout->column_major,
+  };
+  test_ctx->layout = layout;
+}
+
+static FpImage *
+assemble (const FrameLayout *layout, GSList *frames, gboolean direct)
+{
+  TestAsmblCtx test_ctx;
+
+  test_ctx_init (&test_ctx, layout);
+
+  /* Without a known pixel size, every pixel is read through the accessor */
+  if (!direct)
+    test_ctx.ctx.bits_per_pixel = 0;
+
+  fpi_do_movement_estimation (&test_ctx.ctx, frames);
+
+  return fpi_assemble_frames (&test_ctx.ctx, frames);
+}
+
+static void
+test_frames_layout (gconstpointer user_data)
+{
+  const SwipeData *data = user_data;
+  g_autoptr(GRand) rand = g_rand_new_with_seed (0x61736d62);
+  g_autoptr(FpImage) expected = NULL;
+  g_autoptr(FpImage) actual = NULL;
+  g_autofree int *deltas = NULL;
+  GSList *frames, *l;
+  int i;
+
+  frames = swipe_print (rand, data->print, data->layout);
+  deltas = g_new0 (int, g_slist_length (frames) * 2);
+
+  /* Reading the frames directly has to give the same result as
+   * reading every pixel through the accessor. */
+  expected = assemble (data->layout, frames, FALSE);
+  for (l = frames, i = 0; l != NULL; l = l->next, i += 2)
+    {
+      struct fpi_frame *frame = l->data;
+
+      deltas[i] = frame->delta_x;
+      deltas[i + 1] = frame->delta_y;
+    }
+
+  actual = assemble (data->layout, frames, TRUE);
+  for (l = frames, i = 0; l != NULL; l = l->next, i += 2)
+    {
+      struct fpi_frame *frame = l->data;
+
+      g_assert_cmpint (frame->delta_x, ==, deltas[i]);
+      g_assert_cmpint (frame->delta_y, ==, deltas[i + 1]);
+    }
+
+  g_assert_cmpint (actual->width, ==, expected->width);
+  g_assert_cmpint (actual->height, ==, expected->height);
+  g_assert_cmpmem (actual->data, actual->width * actual->height,
+                   expected->data, expected->width * expected->height);
+
+  g_slist_free_full (frames, g_free);
+}
+
+static void
+test_frames_movement (gconstpointer user_data)
+{
+  const SwipeData *data = user_data;
+  g_autoptr(GRand) rand = g_rand_new_with_seed (0x6d6f7665);
+  g_autoptr(FpImage) image = NULL;
+  g_autofree int *deltas = NULL;
+  GSList *frames, *l;
+  int i, n, movements, found = 0;
+
+  frames = swipe_print (rand, data->print, data->layout);
+  n = g_slist_length (frames);
+  deltas = g_new0 (int, n * 2);
+  for (l = frames, i = 0; l != NULL; l = l->next, i += 2)
+    {
+      struct fpi_frame *frame = l->data;
+
+      deltas[i] = frame->delta_x;
+      deltas[i + 1] = frame->delta_y;
+    }
+
+  /* With the frames in the order of the swipe, each one gets the
+   * movement to the next one. The assembling resets the first one. */
+  image = assemble (data->layout, frames, TRUE);
+  for (l = frames->next, i = 2; l->next != NULL; l = l->next, i += 2)
+    {
+      struct fpi_frame *frame = l->data;
+
+      if (frame->delta_x == deltas[i] && frame->delta_y == deltas[i + 1])
+        found++;
+    }
+  g_clear_object (&image);
+
+  /* Swiping the other way round, each one gets the movement from the
+   * previous one. */
+  frames = g_slist_reverse (frames);
+  image = assemble (data->layout, frames, TRUE);
+  for (l = frames->next, i = (n - 2) * 2; l != NULL; l = l->next, i -= 2)
+    {
+      struct fpi_frame *frame = l->data;
+
+      if (frame->delta_x == -deltas[i] && frame->delta_y == -deltas[i + 1])
+        found++;
+    }
+
+  movements = (n - 2) + (n - 1);
+  g_test_message ("%s: %d of %d movements found", data->print, found, movements);
+  g_assert_cmpint (found * 100, >=, movements * MIN_MOVEMENTS_FOUND);
+
+  g_slist_free_full (frames, g_free);
+}
+
+/* Size of the pixel data of a single frame */
+static gsize
+frame_data_size (const FrameLayout *layout)
+{
+  return layout->stride *
+         (layout->column_major ? layout->frame_width : layout->frame_height);
+}
+
+/* Copies the frames into the buffer of the assembler, like a driver would */
+static void
+add_frames (FpiFrameAssembler *assembler, GSList *frames, const FrameLayout *layout)
+{
+  gsize frame_size;
+  GSList *l;
+
+  frame_size = sizeof (struct fpi_frame) + frame_data_size (layout);
+
+  for (l = frames; l != NULL; l = l->next)
+    {
+      memcpy (fpi_frame_assembler_get_next_frame (assembler), l->data, frame_size);
+      fpi_frame_assembler_add_frame (assembler);
+    }
+}
+
+static void
+assert_images_equal (FpImage *actual, FpImage *expected)
+{
+  g_assert_cmpint (actual->width, ==, expected->width);
+  g_assert_cmpint (actual->height, ==, expected->height);
+  g_assert_cmpint (actual->flags, ==, expected->flags);
+  g_assert_cmpmem (actual->data, actual->width * actual->height,
+                   expected->data, expected->width * expected->height);
+}
+
+static void
+test_frames_assembler (gconstpointer user_data)
+{
+  const SwipeData *data = user_data;
+  g_autoptr(GRand) rand = g_rand_new_with_seed (0x73747265);
+  g_autoptr(FpiFrameAssembler) assembler = NULL;
+  TestAsmblCtx test_ctx;
+  GSList *frames;
+  gint i;
+
+  test_ctx_init (&test_ctx, data->layout);
+  frames = swipe_print (rand, data->print, data->layout);
+
+  /* The same assembler is used for a swipe in each direction, and for
+   * one that gets aborted, to check that it starts over each time. */
+  assembler = fpi_frame_assembler_new (&test_ctx.ctx, TRUE);
+  for (i = 0; i < 3; i++)
+    {
+      g_autoptr(FpImage) expected = NULL;
+      g_autoptr(FpImage) actual = NULL;
+
+      if (i == 1)
+        {
+          frames = g_slist_reverse (frames);
+          add_frames (assembler, frames->next, data->layout);
+          fpi_frame_assembler_reset (assembler);
+          g_assert_cmpuint (fpi_frame_assembler_get_n_frames (assembler), ==, 0);
+        }
+
+      add_frames (assembler, frames, data->layout);
+      g_assert_cmpuint (fpi_frame_assembler_get_n_frames (assembler), ==, g_slist_length (frames));
+
+      /* A frame that is not added is dropped */
+      memset (fpi_frame_assembler_get_next_frame (assembler)->data, 0xff,
+              frame_data_size (data->layout));
+
+      actual = fpi_frame_assembler_finish (assembler);
+      g_assert_cmpuint (fpi_frame_assembler_get_n_frames (assembler), ==, 0);
+
+      fpi_do_movement_estimation (&test_ctx.ctx, frames);
+      expected = fpi_assemble_frames (&test_ctx.ctx, frames);
+
+      assert_images_equal (actual, expected);
+
+      if (i == 0)
+        frames = g_slist_reverse (frames);
+    }
+
+  g_slist_free_full (frames, g_free);
+}
+
+static void
+test_frames_assembler_deltas (gconstpointer user_data)
+{
+  const SwipeData *data = user_data;
+  g_autoptr(GRand) rand = g_rand_new_with_seed (0x64656c74);
+  g_autoptr(FpiFrameAssembler) assembler = NULL;
+  g_autoptr(FpImage) expected = NULL;
+  g_autoptr(FpImage) actual = NULL;
+  TestAsmblCtx test_ctx;
+  GSList *frames;
+
+  test_ctx_init (&test_ctx, data->layout);
+  frames = swipe_print (rand, data->print, data->layout);
+
+  /* Like for sensors doing the movement estimation, the frames already
+   * have their deltas, which need to be used as they are. */
+  assembler = fpi_frame_assembler_new (&test_ctx.ctx, FALSE);
+  add_frames (assembler, frames, data->layout);
+  actual = fpi_frame_assembler_finish (assembler);
+
+  expected = fpi_assemble_frames (&test_ctx.ctx, frames);
+
+  assert_images_equal (actual, expected);
+
+  g_slist_free_full (frames, g_free);
+}
+
+/* The layout of the AES drivers */
+static const FrameLayout aes2501_layout = { 192, 16, 4, 8, TRUE };
+static const FrameLayout aes1610_layout = { 128, 8, 4, 4, TRUE };
+/* The layout of the Elan driver */
+static const FrameLayout elan_layout = { 144, 24, 8, 144, FALSE };
+/* Lines with padding at their end */
+static const FrameLayout padded_layout = { 120, 12, 8, 128, FALSE };
+
+static const SwipeData swipes[] = {
+  { "aes2501-arch", "arch.png", &aes2501_layout },
+  { "aes1610-loop-right", "loop-right.png", &aes1610_layout },
+  { "elan-tented-arch", "tented_arch.png", &elan_layout },
+  { "padded-whorl", "whorl.png", &padded_layout },
+  { "aes2501-whorl", "whorl.png", &aes2501_layout },
+  { "aes1610-tented-arch", "tented_arch.png", &aes1610_layout },
+};
+
+int
+main (int argc, char *argv[])
+{
+  gint i;
+
+  g_test_init (&argc, &argv, NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (swipes); i++)
+    {
+      g_autofree gchar *layout_path = NULL;
+      g_autofree gchar *movement_path = NULL;
+      g_autofree gchar *assembler_path = NULL;
+      g_autofree gchar *deltas_path = NULL;
+
+      layout_path = g_strdup_printf ("/assembling/frames/layout/%s", swipes[i].name);
+      movement_path = g_strdup_printf ("/assembling/frames/movement/%s", swipes[i].name);
+      assembler_path = g_strdup_printf ("/assembling/frames/assembler/%s", swipes[i].name);
+      deltas_path = g_strdup_printf ("/assembling/frames/assembler-deltas/%s", swipes[i].name);
+
+      g_test_add_data_func (layout_path, &swipes[i], test_frames_layout);
+      g_test_add_data_func (movement_path, &swipes[i], test_frames_movement);
+      g_test_add_data_func (assembler_path, &swipes[i], test_frames_assembler);
+      g_test_add_data_func (deltas_path, &swipes[i], test_frames_assembler_deltas);
+    }
+
+  return g_test_run ();
+}
@@ -0,0 +1,323 @@
+/*
+ * Check the candidate pre-selection of large galleries
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+#include <nbis.h>
+
+#include "fpi-image.h"
+#include "fpi-print.h"
+#include "fpi-print-index.h"
+#include "test-utils.h"
+
+/* A gallery of a few hundred prints, which is where the index is used */
+#define N_DISTRACTORS 300
+/* The number of prints compared in full, see fp-print-gallery.c */
+#define MIN_CANDIDATES 64
+
+static const gchar *example_prints[] = {
+  "arch.png",
+  "loop-right.png",
+  "tented_arch.png",
+  "whorl.png",
+};
+
+static void
+async_result_ready (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  GAsyncResult **result = user_data;
+
+  *result = g_object_ref (res);
+}
+
+static FpPrint *
+nbis_print_new (void)
+{
+  FpPrint *print;
+
+  print = g_object_ref_sink (g_object_new (FP_TYPE_PRINT,
+                                           "driver", "test",
+                                           "device-id", "test",
+                                           NULL));
+  fpi_print_set_type (print, FP_PRINT_NBIS);
+
+  return print;
+}
+
+/* Enrolls a print from one of the example images, like image devices do */
+static FpPrint *
+print_from_example (const gchar *name)
+{
+  g_autoptr(FpImage) image = NULL;
+  g_autoptr(GAsyncResult) res = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree guint8 *data = NULL;
+  FpPrint *print;
+  gint width, height;
+
+  data = fpt_load_example_print (name, &width, &height);
+  image = fp_image_new (width, height);
+  memcpy (image->data, data, width * height);
+
+  fp_image_detect_minutiae (image, NULL, async_result_ready, &res);
+  while (!res)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_true (fp_image_detect_minutiae_finish (image, res, &error));
+  g_assert_no_error (error);
+
+  print = nbis_print_new ();
+  g_assert_true (fpi_print_add_from_image (print, image, 0, &error));
+  g_assert_no_error (error);
+
+  return print;
+}
+
+/* Simulates another scan of the same finger, which is rotated, shifted,
+ * misses some of the minutiae and finds the others slightly moved. */
+static FpPrint *
+print_rescanned (FpPrint *source, GRand *rand, gdouble rotation,
+                 gint jitter, gdouble drop)
+{
+  struct xyt_struct *src, *xyt;
+  FpPrint *print;
+  gdouble angle = rotation * G_PI / 180.0;
+  gint dx, dy, i;
+
+  print = nbis_print_new ();
+  fpi_print_add_print (print, source);
+
+  src = g_ptr_array_index (fpi_print_get_nbis_prints (source), 0);
+  xyt = g_ptr_array_index (fpi_print_get_nbis_prints (print), 0);
+  xyt->nrows = 0;
+
+  dx = g_rand_int_range (rand, -20, 21);
+  dy = g_rand_int_range (rand, -20, 21);
+
+  for (i = 0; i < src->nrows; i++)
+    {
+      gint theta;
+
+      if (g_rand_double (rand) < drop)
+        continue;
+
+      xyt->xcol[xyt->nrows] = lround (cos (angle) * src->xcol[i] - sin (angle) * src->ycol[i]) +
+                              dx + g_rand_int_range (rand, -jitter, jitter + 1);
+      xyt->ycol[xyt->nrows] = lround (sin (angle) * src->xcol[i] + cos (angle) * src->ycol[i]) +
+                              dy + g_rand_int_range (rand, -jitter, jitter + 1);
+
+      theta = src->thetacol[i] + lround (rotation) +
+              g_rand_int_range (rand, -2 * jitter, 2 * jitter + 1);
+      theta = ((theta + 180) % 360 + 360) % 360 - 180;
+      xyt->thetacol[xyt->nrows] = theta;
+
+      xyt->nrows++;
+    }
+
+  return print;
+}
+
+/* Random minutiae, @template is only used to get a print with one scan */
+static FpPrint *
+print_random (GRand *rand, FpPrint *template)
+{
+  struct xyt_struct *xyt;
+  FpPrint *print;
+  gint i;
+
+  print = nbis_print_new ();
+  fpi_print_add_print (print, template);
+
+  xyt = g_ptr_array_index (fpi_print_get_nbis_prints (print), 0);
+  xyt->nrows = g_rand_int_range (rand, 30, 100);
+  for (i = 0; i < xyt->nrows; i++)
+    {
+      xyt->xcol[i] = g_rand_int_range (rand, 0, 256);
+      xyt->ycol[i] = g_rand_int_range (rand, 0, 240);
+      xyt->thetacol[i] = g_rand_int_range (rand, -179, 181);
+    }
+
+  return print;
+}
+
+static gint
+query_rank (FpiPrintIndex *index, FpPrint *probe, FpPrint *print)
+{
+  g_autoptr(GPtrArray) candidates = NULL;
+  guint i;
+
+  candidates = fpi_print_index_query (index, probe, fpi_print_index_get_n_prints (index));
+
+  if (!g_ptr_array_find (candidates, print, &i))
+    return -1;
+
+  return i;
+}
+
+static void
+assert_same_candidates (GPtrArray *a, GPtrArray *b)
+{
+  guint i;
+
+  g_assert_cmpuint (a->len, ==, b->len);
+  for (i = 0; i < a->len; i++)
+    g_assert_true (g_ptr_array_index (a, i) == g_ptr_array_index (b, i));
+}
+
+static void
+test_print_index_add_remove (void)
+{
+  g_autoptr(FpiPrintIndex) index = fpi_print_index_new ();
+  g_autoptr(FpiPrintIndex) reference = fpi_print_index_new ();
+  g_autoptr(GPtrArray) prints = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autoptr(GPtrArray) expected = NULL;
+  g_autoptr(GPtrArray) actual = NULL;
+  g_autoptr(FpPrint) undefined = NULL;
+  FpPrint *arch, *loop_right, *whorl;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (example_prints); i++)
+    g_ptr_array_add (prints, print_from_example (example_prints[i]));
+  arch = g_ptr_array_index (prints, 0);
+  loop_right = g_ptr_array_index (prints, 1);
+  whorl = g_ptr_array_index (prints, 3);
+
+  /* Only NBIS prints can be indexed */
+  undefined = g_object_ref_sink (g_object_new (FP_TYPE_PRINT, NULL));
+  g_assert_false (fpi_print_index_add (index, undefined));
+  g_assert_cmpuint (fpi_print_index_get_n_prints (index), ==, 0);
+
+  g_assert_true (fpi_print_index_add (index, whorl));
+  g_assert_true (fpi_print_index_add (index, arch));
+  g_assert_false (fpi_print_index_add (index, whorl));
+  g_assert_cmpuint (fpi_print_index_get_n_prints (index), ==, 2);
+  g_assert_true (fpi_print_index_contains (index, whorl));
+  g_assert_false (fpi_print_index_contains (index, loop_right));
+  g_assert_cmpint (query_rank (index, whorl, whorl), ==, 0);
+
+  g_assert_true (fpi_print_index_remove (index, whorl));
+  g_assert_false (fpi_print_index_remove (index, whorl));
+  g_assert_cmpuint (fpi_print_index_get_n_prints (index), ==, 1);
+  g_assert_false (fpi_print_index_contains (index, whorl));
+  g_assert_cmpint (query_rank (index, whorl, whorl), ==, -1);
+
+  /* The slot of the removed print is reused, and must not have kept any
+   * of its votes. So the ranking is the same as for an index that never
+   * contained it. */
+  g_assert_true (fpi_print_index_add (index, loop_right));
+  g_assert_cmpuint (fpi_print_index_get_n_prints (index), ==, 2);
+  g_assert_cmpint (query_rank (index, loop_right, loop_right), ==, 0);
+  g_assert_cmpint (query_rank (index, whorl, whorl), ==, -1);
+
+  fpi_print_index_add (reference, arch);
+  fpi_print_index_add (reference, loop_right);
+  for (i = 0; i < prints->len; i++)
+    {
+      FpPrint *probe = g_ptr_array_index (prints, i);
+
+      g_clear_pointer (&expected, g_ptr_array_unref);
+      g_clear_pointer (&actual, g_ptr_array_unref);
+      expected = fpi_print_index_query (reference, probe, prints->len);
+      actual = fpi_print_index_query (index, probe, prints->len);
+      assert_same_candidates (actual, expected);
+    }
+
+  /* Adding it again gives it a new slot */
+  g_assert_true (fpi_print_index_add (index, whorl));
+  g_assert_cmpuint (fpi_print_index_get_n_prints (index), ==, 3);
+  for (i = 0; i < prints->len; i++)
+    {
+      FpPrint *print = g_ptr_array_index (prints, i);
+
+      if (fpi_print_index_contains (index, print))
+        g_assert_cmpint (query_rank (index, print, print), ==, 0);
+    }
+}
+
+static void
+test_print_index_recall (gconstpointer user_data)
+{
+  const gchar *name = user_data;
+  g_autoptr(GRand) rand = g_rand_new_with_seed (0x696e6478);
+  g_autoptr(FpiPrintIndex) index = fpi_print_index_new ();
+  g_autoptr(GPtrArray) others = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autoptr(GPtrArray) distractors = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autoptr(FpPrint) genuine = NULL;
+  g_autoptr(FpPrint) rescanned = NULL;
+  guint max_candidates;
+  gint rank;
+  guint i;
+
+  genuine = print_from_example (name);
+  for (i = 0; i < G_N_ELEMENTS (example_prints); i++)
+    if (!g_str_equal (example_prints[i], name))
+      g_ptr_array_add (others, print_from_example (example_prints[i]));
+
+  /* Other fingers in any orientation, and prints without any structure */
+  for (i = 0; i < N_DISTRACTORS; i++)
+    {
+      FpPrint *other = g_ptr_array_index (others, i % others->len);
+
+      if (i % 2)
+        g_ptr_array_add (distractors,
+                         print_rescanned (other, rand,
+                                          g_rand_double_range (rand, -180, 180), 3, 0.3));
+      else
+        g_ptr_array_add (distractors, print_random (rand, other));
+    }
+
+  /* Put the genuine print in the middle of the slots */
+  for (i = 0; i < distractors->len; i++)
+    {
+      if (i == distractors->len / 2)
+        g_assert_true (fpi_print_index_add (index, genuine));
+      g_assert_true (fpi_print_index_add (index, g_ptr_array_index (distractors, i)));
+    }
+
+  max_candidates = MAX (MIN_CANDIDATES, fpi_print_index_get_n_prints (index) / 32);
+
+  /* The same image */
+  rank = query_rank (index, genuine, genuine);
+  g_test_message ("%s ranks %d of %u", name, rank, fpi_print_index_get_n_prints (index));
+  g_assert_cmpint (rank, ==, 0);
+
+  /* A different scan of the finger */
+  rescanned = print_rescanned (genuine, rand, g_rand_double_range (rand, -30, 30), 4, 0.3);
+  rank = query_rank (index, rescanned, genuine);
+  g_test_message ("Rescanned %s ranks %d of %u", name, rank, fpi_print_index_get_n_prints (index));
+  g_assert_cmpint (rank, >=, 0);
+  g_assert_cmpint (rank, <, max_candidates);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/print-index/add-remove", test_print_index_add_remove);
+  g_test_add_data_func ("/print-index/recall/arch",
+                        "arch.png", test_print_index_recall);
+  g_test_add_data_func ("/print-index/recall/loop-right",
+                        "loop-right.png", test_print_index_recall);
+  g_test_add_data_func ("/print-index/recall/tented-arch",
+                        "tented_arch.png", test_print_index_recall);
+  g_test_add_data_func ("/print-index/recall/whorl",
+                        "whorl.png", test_print_index_recall);
+
+  return g_test_run ();
+}
@@ -0,0 +1,118 @@
+/*
+ * Check the optimized mindtct DFT direction powers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <glib.h>
+#include <string.h>
+#include <nbis.h>
+
+#define IMAGE_WIDTH 256
+#define IMAGE_HEIGHT 360
+
+static void
+assert_powers_equal (unsigned char *pdata, int pw, int ph, int blkoffset,
+                     const DFTWAVES *dftwaves, const ROTGRIDS *dftgrids)
+{
+  g_autofree int *rowsums = g_new0 (int, dftgrids->grid_w);
+  double **expected, **actual;
+  int w, dir;
+
+  g_assert_cmpint (alloc_dir_powers (&expected, dftwaves->nwaves, dftgrids->ngrids), ==, 0);
+  g_assert_cmpint (alloc_dir_powers (&actual, dftwaves->nwaves, dftgrids->ngrids), ==, 0);
+
+  /* The plain NBIS computation */
+  for (dir = 0; dir < dftgrids->ngrids; dir++)
+    {
+      sum_rot_block_rows (rowsums, pdata + blkoffset, dftgrids->grids[dir], dftgrids->grid_w);
+      for (w = 0; w < dftwaves->nwaves; w++)
+        dft_power (&expected[w][dir], rowsums, dftwaves->waves[w], dftwaves->wavelen);
+    }
+
+  g_assert_cmpint (dft_dir_powers (actual, pdata, blkoffset, pw, ph, dftwaves, dftgrids), ==, 0);
+
+  /* The powers decide the direction map, so they need to be bit identical */
+  for (w = 0; w < dftwaves->nwaves; w++)
+    g_assert_cmpmem (actual[w], sizeof (double) * dftgrids->ngrids,
+                     expected[w], sizeof (double) * dftgrids->ngrids);
+
+  free_dir_powers (expected, dftwaves->nwaves);
+  free_dir_powers (actual, dftwaves->nwaves);
+}
+
+static void
+test_dft_dir_powers (gconstpointer user_data)
+{
+  const LFSPARMS *lfsparms = &g_lfsparms_V2;
+  int nwaves = GPOINTER_TO_INT (user_data);
+  g_autoptr(GRand) rand = g_rand_new_with_seed (0x64667470);
+  g_autofree unsigned char *pdata = NULL;
+  DFTWAVES *dftwaves;
+  ROTGRIDS *dftgrids;
+  int maxpad, pw, ph, x, y, i;
+  int simd, max_simd;
+
+  maxpad = get_max_padding_V2 (lfsparms->windowsize, lfsparms->windowoffset,
+                               lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h);
+  pw = IMAGE_WIDTH + 2 * maxpad;
+  ph = IMAGE_HEIGHT + 2 * maxpad;
+
+  g_assert_cmpint (init_dftwaves (&dftwaves, g_dft_coefs, nwaves, lfsparms->windowsize), ==, 0);
+  g_assert_cmpint (init_rotgrids (&dftgrids, IMAGE_WIDTH, IMAGE_HEIGHT, maxpad,
+                                  lfsparms->start_dir_angle, lfsparms->num_directions,
+                                  lfsparms->windowsize, lfsparms->windowsize,
+                                  RELATIVE2ORIGIN), ==, 0);
+
+  pdata = g_malloc (pw * ph);
+  for (i = 0; i < pw * ph; i++)
+    pdata[i] = g_rand_int_range (rand, 0, 256);
+
+  /* Every instruction set this processor supports, down to the scalar code */
+  max_simd = dftwaves->simd;
+  for (simd = 0; simd <= max_simd; simd++)
+    {
+      dftwaves->simd = simd;
+
+      /* Every window that the rotated grids can sample without leaving the
+       * padded image, which includes the ones right at its end. */
+      for (y = dftgrids->pad; y <= ph - dftgrids->pad - dftgrids->grid_h; y += 7)
+        for (x = dftgrids->pad; x <= pw - dftgrids->pad - dftgrids->grid_w; x += 5)
+          assert_powers_equal (pdata, pw, ph, y * pw + x, dftwaves, dftgrids);
+
+      y = ph - dftgrids->pad - dftgrids->grid_h;
+      x = pw - dftgrids->pad - dftgrids->grid_w;
+      assert_powers_equal (pdata, pw, ph, y * pw + x, dftwaves, dftgrids);
+    }
+
+  free_dftwaves (dftwaves);
+  free_rotgrids (dftgrids);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_data_func ("/mindtct/dft_dir_powers/default",
+                        GINT_TO_POINTER (NUM_DFT_WAVES), test_dft_dir_powers);
+  /* Wave counts that leave a remainder after the widest vectors */
+  g_test_add_data_func ("/mindtct/dft_dir_powers/3-waves",
+                        GINT_TO_POINTER (3), test_dft_dir_powers);
+  g_test_add_data_func ("/mindtct/dft_dir_powers/1-wave",
+                        GINT_TO_POINTER (1), test_dft_dir_powers);
+
+  return g_test_run ();
+}
@@ -0,0 +1,128 @@
+/*
+ * Compare the fixed point minutiae detection with the floating point one
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <nbis.h>
+
+#include "test-utils.h"
+
+/* Minutiae closer than this are considered the same */
+#define MAX_DISTANCE 2
+#define MAX_DIRECTION_DELTA 1
+/* Percentage of minutiae that need to be found by both */
+#define MIN_AGREEMENT 95
+
+static MINUTIAE *
+scan_minutiae (const guchar *image, gint width, gint height, gboolean fixed_point)
+{
+  LFSPARMS lfsparms = g_lfsparms_V2;
+  g_autofree guchar *data = g_memdup (image, width * height);
+  MINUTIAE *minutiae;
+  int *quality_map, *direction_map, *low_contrast_map;
+  int *low_flow_map, *high_curve_map;
+  int map_w, map_h;
+  unsigned char *bdata;
+  int bw, bh, bd;
+
+  lfsparms.fixed_point = fixed_point;
+
+  g_assert_cmpint (get_minutiae (&minutiae, &quality_map, &direction_map,
+                                 &low_contrast_map, &low_flow_map, &high_curve_map,
+                                 &map_w, &map_h, &bdata, &bw, &bh, &bd,
+                                 data, width, height, 8, DEFAULT_PPI / 25.4,
+                                 &lfsparms), ==, 0);
+
+  g_free (quality_map);
+  g_free (direction_map);
+  g_free (low_contrast_map);
+  g_free (low_flow_map);
+  g_free (high_curve_map);
+  g_free (bdata);
+
+  return minutiae;
+}
+
+static gboolean
+find_minutia (MINUTIAE *minutiae, MINUTIA *minutia)
+{
+  int i;
+
+  for (i = 0; i < minutiae->num; i++)
+    {
+      MINUTIA *other = minutiae->list[i];
+      int delta = abs (other->direction - minutia->direction);
+
+      /* Directions wrap around */
+      delta = MIN (delta, NUM_DIRECTIONS * 2 - delta);
+
+      if (abs (other->x - minutia->x) <= MAX_DISTANCE &&
+          abs (other->y - minutia->y) <= MAX_DISTANCE &&
+          delta <= MAX_DIRECTION_DELTA)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+test_fixed_point_agreement (gconstpointer user_data)
+{
+  const gchar *name = user_data;
+  g_autofree guchar *image = NULL;
+  MINUTIAE *expected, *actual;
+  gint width, height;
+  gint i, found = 0;
+
+  image = fpt_load_example_print (name, &width, &height);
+
+  expected = scan_minutiae (image, width, height, FALSE);
+  actual = scan_minutiae (image, width, height, TRUE);
+
+  for (i = 0; i < expected->num; i++)
+    if (find_minutia (actual, expected->list[i]))
+      found++;
+
+  g_test_message ("%s: %d of %d minutiae found, %d detected",
+                  name, found, expected->num, actual->num);
+
+  g_assert_cmpint (expected->num, >, 0);
+  g_assert_cmpint (found * 100, >=, expected->num * MIN_AGREEMENT);
+  g_assert_cmpint (actual->num * 100, <=, expected->num * (200 - MIN_AGREEMENT));
+
+  free_minutiae (expected);
+  free_minutiae (actual);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_data_func ("/mindtct/fixed-point/arch",
+                        "arch.png", test_fixed_point_agreement);
+  g_test_add_data_func ("/mindtct/fixed-point/loop-right",
+                        "loop-right.png", test_fixed_point_agreement);
+  g_test_add_data_func ("/mindtct/fixed-point/tented-arch",
+                        "tented_arch.png", test_fixed_point_agreement);
+  g_test_add_data_func ("/mindtct/fixed-point/whorl",
+                        "whorl.png", test_fixed_point_agreement);
+
+  return g_test_run ();
+}
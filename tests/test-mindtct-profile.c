@@ -0,0 +1,135 @@
+/*
+ * Check that the mindtct extraction profiles detect the same minutiae
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <nbis.h>
+
+#define IMAGE_WIDTH 256
+#define IMAGE_HEIGHT 360
+#define RIDGE_PERIOD 9.0
+#define N_SINGULARITIES 40
+
+/* Concentric ridges, with point singularities that each add or remove
+ * a ridge and so create minutiae. */
+static guchar *
+generate_print (void)
+{
+  g_autoptr(GRand) rand = g_rand_new_with_seed (0x70726f66);
+  guchar *image = g_malloc (IMAGE_WIDTH * IMAGE_HEIGHT);
+  gdouble sx[N_SINGULARITIES], sy[N_SINGULARITIES];
+  gdouble cx = IMAGE_WIDTH / 2.0, cy = IMAGE_HEIGHT / 2.0;
+  gint x, y, i;
+
+  for (i = 0; i < N_SINGULARITIES; i++)
+    {
+      sx[i] = g_rand_double_range (rand, 20, IMAGE_WIDTH - 20);
+      sy[i] = g_rand_double_range (rand, 20, IMAGE_HEIGHT - 20);
+    }
+
+  for (y = 0; y < IMAGE_HEIGHT; y++)
+    for (x = 0; x < IMAGE_WIDTH; x++)
+      {
+        gdouble phase = hypot (x - cx, y - cy) * 2 * G_PI / RIDGE_PERIOD;
+
+        for (i = 0; i < N_SINGULARITIES; i++)
+          phase += (i % 2 ? 1 : -1) * atan2 (y - sy[i], x - sx[i]);
+
+        image[y * IMAGE_WIDTH + x] = 128 + 90 * sin (phase);
+      }
+
+  return image;
+}
+
+static MINUTIAE *
+scan_minutiae (const guchar *image, gint profile)
+{
+  LFSPARMS lfsparms = g_lfsparms_V2;
+  g_autofree guchar *data = g_memdup (image, IMAGE_WIDTH * IMAGE_HEIGHT);
+  MINUTIAE *minutiae;
+  int *quality_map, *direction_map, *low_contrast_map;
+  int *low_flow_map, *high_curve_map;
+  int map_w, map_h;
+  unsigned char *bdata;
+  int bw, bh, bd;
+
+  lfsparms.profile = profile;
+
+  g_assert_cmpint (get_minutiae (&minutiae, &quality_map, &direction_map,
+                                 &low_contrast_map, &low_flow_map, &high_curve_map,
+                                 &map_w, &map_h, &bdata, &bw, &bh, &bd,
+                                 data, IMAGE_WIDTH, IMAGE_HEIGHT, 8, DEFAULT_PPI / 25.4,
+                                 &lfsparms), ==, 0);
+
+  g_free (quality_map);
+  g_free (direction_map);
+  g_free (low_contrast_map);
+  g_free (low_flow_map);
+  g_free (high_curve_map);
+  g_free (bdata);
+
+  return minutiae;
+}
+
+static void
+test_profile_xyt (void)
+{
+  g_autofree guchar *image = generate_print ();
+  MINUTIAE *full, *xyt;
+  gint i, nbrs = 0;
+
+  full = scan_minutiae (image, LFS_PROFILE_FULL);
+  xyt = scan_minutiae (image, LFS_PROFILE_XYT);
+
+  g_assert_cmpint (full->num, >, 0);
+  g_assert_cmpint (xyt->num, ==, full->num);
+
+  for (i = 0; i < full->num; i++)
+    {
+      MINUTIA *expected = full->list[i];
+      MINUTIA *actual = xyt->list[i];
+
+      g_assert_cmpint (actual->x, ==, expected->x);
+      g_assert_cmpint (actual->y, ==, expected->y);
+      g_assert_cmpint (actual->direction, ==, expected->direction);
+      g_assert_cmpint (actual->type, ==, expected->type);
+      g_assert_cmpfloat (actual->reliability, ==, expected->reliability);
+
+      g_assert_null (actual->nbrs);
+      g_assert_null (actual->ridge_counts);
+      g_assert_cmpint (actual->num_nbrs, ==, 0);
+
+      nbrs += expected->num_nbrs;
+    }
+
+  /* Otherwise the full profile did not do any more work */
+  g_assert_cmpint (nbrs, >, 0);
+
+  free_minutiae (full);
+  free_minutiae (xyt);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/mindtct/profile/xyt", test_profile_xyt);
+
+  return g_test_run ();
+}
@@ -0,0 +1,63 @@
+/*
+ * Shared helpers for the libfprint tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <cairo.h>
+#include <string.h>
+
+#include "test-utils.h"
+
+/* Loads one of the PNG files in examples/prints as 8 bit greyscale data,
+ * row by row without padding. */
+guint8 *
+fpt_load_example_print (const gchar *name, gint *width, gint *height)
+{
+  g_autofree gchar *path = NULL;
+  cairo_surface_t *png;
+  cairo_surface_t *img;
+  cairo_t *cr;
+  guint8 *data;
+  gint stride, y;
+
+  path = g_build_filename (EXAMPLE_PRINTS_DIR, name, NULL);
+  png = cairo_image_surface_create_from_png (path);
+  g_assert_cmpint (cairo_surface_status (png), ==, CAIRO_STATUS_SUCCESS);
+
+  *width = cairo_image_surface_get_width (png);
+  *height = cairo_image_surface_get_height (png);
+
+  /* The greyscale data is the mask of the PNG, see virtual-image.py */
+  img = cairo_image_surface_create (CAIRO_FORMAT_A8, *width, *height);
+  cr = cairo_create (img);
+  cairo_set_source_rgba (cr, 1, 1, 1, 1);
+  cairo_paint (cr);
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_surface (cr, png, 0, 0);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+  cairo_surface_flush (img);
+
+  stride = cairo_image_surface_get_stride (img);
+  data = g_malloc (*width * *height);
+  for (y = 0; y < *height; y++)
+    memcpy (data + y * *width, cairo_image_surface_get_data (img) + y * stride, *width);
+
+  cairo_surface_destroy (img);
+  cairo_surface_destroy (png);
+
+  return data;
+}
@@ -206,6 +206,19 @@ class VirtualImage(unittest.TestCase):
 
         return self._enrolled
 
+    def verify_print(self, template, image):
+        self._verify_match = None
+
+        def verify_cb(dev, res):
+            self._verify_match, self._verify_fp = dev.verify_finish(res)
+
+        self.dev.verify(template, None, verify_cb)
+        self.send_image(image)
+        while self._verify_match is None:
+            ctx.iteration(True)
+
+        return self._verify_match, self._verify_fp
+
     def test_enroll_verify(self):
         done = False
 
@@ -232,6 +245,30 @@ class VirtualImage(unittest.TestCase):
             ctx.iteration(True)
         assert(not self._verify_match)
 
+    def test_verify_blank_image(self):
+        def verify_cb(dev, res):
+            try:
+                self._verify_match, self._verify_fp = dev.verify_finish(res)
+            except GLib.GError as e:
+                self._verify_error = e
+
+        fp_whorl = self.enroll_print('whorl')
+
+        # An empty capture is rejected before trying to detect minutiae
+        blank = cairo.ImageSurface(cairo.Format.A8, 256, 240)
+        cr = cairo.Context(blank)
+        cr.set_source_rgba(1, 1, 1, 1)
+        cr.paint()
+        self.prints['blank'] = blank
+
+        self._verify_error = None
+        self.dev.verify(fp_whorl, None, verify_cb)
+        self.send_image('blank')
+        while self._verify_error is None:
+            ctx.iteration(True)
+        assert(self._verify_error.matches(FPrint.device_retry_quark(),
+                                          FPrint.DeviceRetry.GENERAL))
+
     def test_identify(self):
         done = False
 
@@ -261,6 +298,195 @@ class VirtualImage(unittest.TestCase):
             ctx.iteration(True)
         assert(self._identify_match is fp_whorl)
 
+    def test_print_gallery(self):
+        fp_whorl = self.enroll_print('whorl')
+        fp_tented_arch = self.enroll_print('tented_arch')
+        fp_arch = self.enroll_print('arch')
+
+        gallery = FPrint.PrintGallery.new()
+        assert(gallery.get_n_prints() == 0)
+
+        assert(gallery.add(fp_whorl))
+        assert(gallery.add(fp_tented_arch))
+        assert(not gallery.add(fp_whorl))
+        assert(gallery.get_n_prints() == 2)
+        assert(gallery.get_prints() == [fp_whorl, fp_tented_arch])
+
+        # Prints are found again after e.g. loading them from disk
+        fp_whorl_new = FPrint.Print.deserialize(fp_whorl.serialize())
+        assert(gallery.lookup(fp_whorl_new) is fp_whorl)
+        assert(gallery.lookup(fp_whorl) is fp_whorl)
+        assert(gallery.lookup(fp_arch) is None)
+
+        assert(not gallery.remove(fp_arch))
+        assert(gallery.remove(fp_tented_arch))
+        assert(not gallery.remove(fp_tented_arch))
+        assert(gallery.get_n_prints() == 1)
+        assert(gallery.lookup(fp_tented_arch) is None)
+        assert(gallery.get_prints() == [fp_whorl])
+
+    def test_identify_gallery(self):
+        fp_whorl = self.enroll_print('whorl')
+        fp_tented_arch = self.enroll_print('tented_arch')
+
+        gallery = FPrint.PrintGallery.new()
+        gallery.add(fp_whorl)
+        gallery.add(fp_tented_arch)
+
+        def identify_cb(dev, res):
+            print('Identify finished')
+            self._identify_match, self._identify_fp = dev.identify_finish(res)
+
+        self._identify_fp = None
+        self.dev.identify_gallery(gallery, None, identify_cb)
+        self.send_image('tented_arch')
+        while self._identify_fp is None:
+            ctx.iteration(True)
+        assert(self._identify_match is fp_tented_arch)
+
+        # A finger that is not in the gallery
+        self._identify_fp = None
+        self.dev.identify_gallery(gallery, None, identify_cb)
+        self.send_image('loop-right')
+        while self._identify_fp is None:
+            ctx.iteration(True)
+        assert(self._identify_match is None)
+
+        # Changing the gallery does not affect a running identification
+        self._identify_fp = None
+        self.dev.identify_gallery(gallery, None, identify_cb)
+        gallery.remove(fp_whorl)
+        self.send_image('whorl')
+        while self._identify_fp is None:
+            ctx.iteration(True)
+        assert(self._identify_match is fp_whorl)
+
+        # But it does affect the next one
+        def send_whorl():
+            self.send_image('whorl', iterate=False)
+            return False
+
+        GLib.idle_add(send_whorl)
+        match, fp = self.dev.identify_gallery_sync(gallery, None)
+        assert(match is None)
+        assert(fp is not None)
+
+        gallery.add(fp_whorl)
+        GLib.idle_add(send_whorl)
+        match, fp = self.dev.identify_gallery_sync(gallery, None)
+        assert(match is fp_whorl)
+
+    def test_identify_large_gallery(self):
+        fp_whorl = self.enroll_print('whorl')
+        fp_tented_arch = self.enroll_print('tented_arch')
+
+        # Large enough to be searched through the index
+        gallery = FPrint.PrintGallery.new()
+        whorls = []
+        for i in range(150):
+            whorls.append(FPrint.Print.deserialize(fp_whorl.serialize()))
+            gallery.add(whorls[-1])
+            gallery.add(FPrint.Print.deserialize(fp_tented_arch.serialize()))
+
+        def send_image(name):
+            self.send_image(name, iterate=False)
+            return False
+
+        GLib.idle_add(send_image, 'whorl')
+        match, fp = self.dev.identify_gallery_sync(gallery, None)
+        assert(match in whorls)
+
+        # Nothing matches, so the prints the index skipped are compared too
+        GLib.idle_add(send_image, 'loop-right')
+        match, fp = self.dev.identify_gallery_sync(gallery, None)
+        assert(match is None)
+        assert(fp is not None)
+
+    def test_identify_ranked(self):
+        fp_whorl = self.enroll_print('whorl')
+        fp_tented_arch = self.enroll_print('tented_arch')
+        fp_arch = self.enroll_print('arch')
+        fp_loop_right = self.enroll_print('loop-right')
+        prints = [fp_whorl, fp_tented_arch, fp_arch, fp_loop_right]
+
+        def identify_ranked_cb(dev, res):
+            print('Ranked identify finished')
+            self._candidates, self._identify_fp = dev.identify_ranked_finish(res)
+
+        for max_results in (1, 2, len(prints)):
+            self._identify_fp = None
+            self.dev.identify_ranked(prints, max_results, None, identify_ranked_cb)
+            self.send_image('whorl')
+            while self._identify_fp is None:
+                ctx.iteration(True)
+
+            assert(1 <= len(self._candidates) <= max_results)
+            scores = [c.get_score() for c in self._candidates]
+            assert(scores == sorted(scores, reverse=True))
+
+            # The genuine print is the only one to match
+            assert(self._candidates[0].get_print() is fp_whorl)
+            assert(self._candidates[0].is_match())
+            for c in self._candidates[1:]:
+                assert(c.get_print() is not fp_whorl)
+                assert(not c.is_match())
+
+    def test_print_match(self):
+        fp_whorl = self.enroll_print('whorl')
+        fp_tented_arch = self.enroll_print('tented_arch')
+
+        matched, probe_whorl = self.verify_print(fp_whorl, 'whorl')
+        assert(matched)
+        matched, probe_tented_arch = self.verify_print(fp_whorl, 'tented_arch')
+        assert(not matched)
+
+        # The same finger matches, using the default threshold of image devices
+        matched, score = fp_whorl.match(probe_whorl, 40)
+        assert(matched)
+        assert(score >= 40)
+
+        # The result only depends on the score, not on whether it is requested
+        matched, same_score = fp_whorl.match(probe_whorl, score + 1)
+        assert(not matched)
+        assert(same_score == score)
+
+        # A different finger does not match
+        matched, score = fp_tented_arch.match(probe_whorl, 40)
+        assert(not matched)
+        assert(0 <= score < 40)
+        matched, score = fp_whorl.match(probe_tented_arch, 40)
+        assert(not matched)
+        assert(0 <= score < 40)
+
+        # The probe must be a single scan
+        with self.assertRaises(GLib.GError) as cm:
+            probe_whorl.match(fp_whorl, 40)
+        assert cm.exception.matches(FPrint.device_error_quark(), FPrint.DeviceError.GENERAL)
+
+    def test_print_match_batch(self):
+        fp_whorl = self.enroll_print('whorl')
+        fp_tented_arch = self.enroll_print('tented_arch')
+        fp_arch = self.enroll_print('arch')
+        prints = [fp_tented_arch, fp_whorl, fp_arch, fp_whorl]
+
+        matched, probe = self.verify_print(fp_whorl, 'whorl')
+        assert(matched)
+
+        candidates = probe.match_batch(prints, 40, None)
+
+        # One candidate per print, in the order of the prints
+        assert(len(candidates) == len(prints))
+        for fp, candidate in zip(prints, candidates):
+            assert(candidate.get_print() is fp)
+
+            # Scored the same way as fp_print_match()
+            matched, score = fp.match(probe, 40)
+            assert(candidate.get_score() == score)
+            assert(candidate.is_match() == matched)
+            assert(candidate.is_match() == (fp is fp_whorl))
+
+        assert(probe.match_batch([], 40, None) == [])
+
     def test_verify_serialized(self):
         done = False
 